@@ -41,21 +41,28 @@
  * contribution of throughput to the performance index. Once the
  * students surpass the AVG_LIBC_THRUPUT, they get no further benefit
  * to their score.  This deters students from building extremely fast,
- * but extremely stupid malloc packages.
+ * but extremely stupid malloc packages. This is the default; mdriver -c
+ * sets another cap, or measures libc on the host with -c libc.
  */
 #define AVG_LIBC_THRUPUT      600E3  /* 600 Kops/sec */
 
  /* 
   * This constant determines the contributions of space utilization
   * (UTIL_WEIGHT) and throughput (1 - UTIL_WEIGHT) to the performance
-  * index.  
+  * index. mdriver -w overrides it.
   */
 #define UTIL_WEIGHT .60
 
 /* 
- * Alignment requirement in bytes (either 4 or 8) 
+ * Alignment requirement in bytes (either 4 or 8). 64-bit builds use 16,
+ * which is what the system malloc guarantees on LP64 machines, except
+ * for the compact (MM_COMPACT) block format which keeps 4 byte tags.
  */
+#if defined(__LP64__) && !defined(MM_COMPACT)
+#define ALIGNMENT 16
+#else
 #define ALIGNMENT 8  
+#endif
 
 /* 
  * Maximum heap size in bytes 
@@ -7,14 +7,18 @@
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
  */
+#define _GNU_SOURCE /* sched_setaffinity */
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
 #include <float.h>
 #include <time.h>
+#include <math.h>
 
 #include "mm.h"
 #include "memlib.h"
@@ -31,7 +35,41 @@
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
+#define IS_ALIGNED(p)  ((((size_t)(p)) % ALIGNMENT) == 0)
+
+/* Build metadata for the -o report; the Makefile passes in the CFLAGS */
+#ifndef BUILD_CFLAGS
+#define BUILD_CFLAGS "unknown"
+#endif
+#if USE_FCYC
+#define TIMER_NAME "fcyc"
+#elif USE_ITIMER
+#define TIMER_NAME "itimer"
+#else
+#define TIMER_NAME "gettimeofday"
+#endif
+
+/* How much of each payload eval_mm_valid writes and checks (-m) */
+#define CHECK_FULL   0  /* every byte */
+#define CHECK_SAMPLE 1  /* every byte of every check_every'th block id, the 
+			   first and last check_edge bytes of the others */
+#define CHECK_OFF    2  /* none, only the block extents are checked */
+
+/* Formats of the machine readable report (-o) */
+#define OUT_NONE 0
+#define OUT_JSON 1
+#define OUT_CSV  2
+
+/* 
+ * Baselines (-B, -C). A trace has regressed if its throughput dropped by
+ * more than THRU_TOLERANCE and by more than THRU_SIGMAS standard errors
+ * of the difference, or if its utilization dropped at all (it does not
+ * depend on timing)
+ */
+#define BASELINE_SAMPLES 5    /* times each trace is timed for a baseline */
+#define THRU_TOLERANCE   0.05 /* default, set with -C <file>,<fraction> */
+#define THRU_SIGMAS      3.0
+#define UTIL_TOLERANCE   5e-5 /* what %.4f in the baseline can't show */
 
 /****************************** 
  * The key compound data types 
@@ -46,9 +84,17 @@ typedef struct range_t {
 
 /* Characterizes a single trace operation (allocator request) */
 typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
+    enum {ALLOC, FREE, REALLOC, MEMALIGN, CALLOC, 
+	  ALLOC_BATCH, FREE_BATCH,
+	  ARENA_BEGIN, ARENA_ALLOC, ARENA_FREE, ARENA_END} type; /* type of request */
     int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
+    int size;                         /* byte size of alloc/realloc request,
+					 or of the block a free releases */
+    int alignment;                    /* alignment of memalign request */
+    int count;                        /* number of ids index.. in a batch, 
+					 or of ids released by ARENA_END */
+    int scope;                        /* arena scope of ARENA_* requests */
+    int *ids;                         /* ids released by ARENA_END */
 } traceop_t;
 
 /* Holds the information for one trace file*/
@@ -57,11 +103,25 @@ typedef struct {
     int num_ids;         /* number of alloc/realloc ids */
     int num_ops;         /* number of distinct requests */
     int weight;          /* weight for this trace (unused) */
+    int num_scopes;      /* number of arena scope numbers used */
     traceop_t *ops;      /* array of requests */
     char **blocks;       /* array of ptrs returned by malloc/realloc... */
     size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    mm_arena_t **arenas; /* the arena of each scope number, while evaluating */
 } trace_t;
 
+/* Heap layout at one point of a trace, from the allocator's heap walk */
+#define FRAG_BUCKETS 24 /* free block size classes [16<<i, 32<<i) in the histogram */
+typedef struct {
+    size_t alloc_blocks;       /* allocated blocks... */
+    size_t alloc_bytes;        /* ... their size including tags... */
+    size_t usable_bytes;       /* ... and the payload they can hold */
+    size_t free_blocks;        /* free blocks... */
+    size_t free_bytes;         /* ... their total size... */
+    size_t largest_free;       /* ... and the largest one */
+    size_t hist[FRAG_BUCKETS]; /* number of free blocks per size class */
+} frag_t;
+
 /* 
  * Holds the params to the xxx_speed functions, which are timed by fcyc. 
  * This struct is necessary because fcyc accepts only a pointer array
@@ -78,20 +138,63 @@ typedef struct {
     double ops;      /* number of ops (malloc/free/realloc) in the trace */
     int valid;       /* was the trace processed correctly by the allocator? */
     double secs;     /* number of secs needed to run the trace */
+    int samples;     /* number of times secs was measured (mean of them) */
+    double kops_sd;  /* standard deviation of the Kops of those samples */
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    double heap;     /* heap size at the end of the trace, i.e. its peak */
+    int counted;         /* were the op counters below kept (-DMM_STATS)? */
+    mm_stats_t counters; /* op counters of the util pass */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+/* Summarizes the results of one allocator variant over all the traces */
+typedef struct {
+    mm_allocator_t *allocator; /* the variant (see mm-registry.c) */
+    stats_t *stats;            /* one stats_t struct per tracefile */
+    int errors;                /* number of errs found when running it */
+    double perfindex;          /* its performance index */
+    double thruput;            /* its average throughput (ops/sec), uncapped */
+} variant_t;
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
+static mm_allocator_t *allocator; /* the mm malloc package being evaluated */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
+/* Fragmentation timeline (-s), sampled during the utilization pass */
+static int frag_every = 0;   /* sample the heap every this many ops, 0 for never */
+static int frag_json = 0;    /* write JSON instead of CSV */
+static FILE *frag_fp = NULL; /* timeline of the trace being evaluated */
+static int frag_rows;        /* samples written to frag_fp so far */
+
+/* Machine readable report (-o) */
+static int out_format = OUT_NONE; /* OUT_JSON or OUT_CSV if one was asked for */
+static FILE *out_fp = NULL;       /* where it goes */
+
+/* Baselines (-B, -C) */
+static int num_samples = 1;  /* times each trace is timed */
+
+/* Performance index (-w, -c). Defaults are from config.h */
+static double util_weight = UTIL_WEIGHT; /* weight of util, 1 - it of throughput */
+static double thru_cap = AVG_LIBC_THRUPUT; /* throughput (ops/sec) that scores full marks */
+
+/* Payload checks (-m) */
+static int check_mode = CHECK_FULL;
+static int check_every = 16;
+static int check_edge = 64;
+
+/* Parallel evaluation (-j) */
+static int num_workers = 1;  /* traces evaluated at once, one process each */
+static int timing_token[2] = {-1, -1}; /* pipe holding the one token that 
+					  lets a worker time its trace 
+					  (-j n,serial) */
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -124,9 +227,38 @@ static void eval_libc_speed(void *ptr);
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_trace(char *tracefile, int tracenum, 
+			  variant_t *variants, int num_variants);
+static void eval_mm_parallel(char **tracefiles, int n, 
+			     variant_t *variants, int num_variants);
+static void fill_payload(char *p, int size, int id);
+static int payload_ok(char *p, int id, int filled, int len, int byte);
+static void *mm_calloc_or_emulate(size_t size);
+static size_t mm_malloc_batch_or_emulate(size_t size, size_t n, char **ptrs);
+static void mm_free_batch_or_emulate(char **ptrs, size_t n);
+static void mm_free_sized_or_emulate(void *ptr, size_t size);
+static int arena_begin(trace_t *trace, int scope);
+static void *arena_alloc_or_emulate(trace_t *trace, int scope, size_t size);
+static void arena_free_or_emulate(void *ptr);
+static void arena_end_or_emulate(trace_t *trace, traceop_t *op);
+static void arena_destroy_all(trace_t *trace);
+
+/* Routines that record the fragmentation timeline */
+static void frag_open(char *tracefile);
+static void frag_walk(void *bp, size_t size, size_t usable, int alloc, void *arg);
+static void frag_sample(int op, int live);
+static void frag_close(void);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printcounters(int n, stats_t *stats);
+static void printreport(char **tracefiles, int n, variant_t *variants, 
+			int num_variants, stats_t *libc_stats);
+static void time_trace(fsecs_test_funct f, speed_t *params, stats_t *stats);
+static void save_baseline(char *file, char **tracefiles, int n, 
+			  variant_t *variants, int num_variants);
+static int compare_baseline(char *file, double tolerance, char **tracefiles, 
+			    int n, variant_t *variants, int num_variants);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -137,19 +269,31 @@ static void app_error(char *msg);
  **************/
 int main(int argc, char **argv)
 {
-    int i;
+    int i, j;
     char c;
     char **tracefiles = NULL;  /* null-terminated array of trace file names */
     int num_tracefiles = 0;    /* the number of traces in that array */
     trace_t *trace = NULL;     /* stores a single trace file in memory */
-    range_t *ranges = NULL;    /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
-    stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
+    stats_t *variant_stats = NULL; /* mm (i.e. student) stats for each trace */
+    char *variant_name = "mm"; /* allocator variant(s) to evaluate (-A) */
+    variant_t *variants = NULL;/* the selected variants and their stats */
+    int num_variants = 1;      /* the number of variants in that array */
     speed_t speed_params;      /* input parameters to the xx_speed routines */ 
 
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    char *out_file = NULL; /* file for the -o report, stdout if NULL */
+    char *save_file = NULL;    /* baseline to write (-B) */
+    char *compare_file = NULL; /* baseline to compare against (-C) */
+    double tolerance = THRU_TOLERANCE; /* smallest throughput drop flagged */
+    int regressions = 0;       /* traces worse than the baseline */
+    double libc_cap = 0;       /* if set, cap at this times libc's throughput (-c) */
+    int debug_level = 0; /* mm.c debug level (-d) */
+    int debug_sweep = 1024; /* operations between full heap checks (-d) */
+    char *end;           /* end of a parsed number */
+    char *p;             /* separator in an option argument */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -158,8 +302,109 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:hvVgalA:d:s:o:B:C:c:w:j:m:")) != EOF) {
         switch (c) {
+	case 'm': /* Payload checks: full, sample[,<n>[,<bytes>]] or off */
+	    if (!strcmp(optarg, "full"))
+		check_mode = CHECK_FULL;
+	    else if (!strcmp(optarg, "off"))
+		check_mode = CHECK_OFF;
+	    else if (!strncmp(optarg, "sample", 6) &&
+		     (optarg[6] == '\0' || optarg[6] == ',')) {
+		check_mode = CHECK_SAMPLE;
+		if ((sscanf(optarg, "sample,%d,%d", &check_every, &check_edge) < 1 &&
+		     optarg[6] == ',') || check_every <= 0 || check_edge < 0) {
+		    usage();
+		    exit(1);
+		}
+	    }
+	    else {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'j': /* Evaluate n traces at once: n[,serial] */
+	    if ((num_workers = atoi(optarg)) <= 0)
+		num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	    if (strstr(optarg, "serial") != NULL) {
+		if (pipe(timing_token) < 0 || write(timing_token[1], "t", 1) != 1)
+		    unix_error("timing token pipe in main failed");
+	    }
+	    break;
+	case 'c': /* Throughput cap: <Kops>, or libc[,<factor>] */
+	    if (!strncmp(optarg, "libc", 4)) {
+		libc_cap = 1.0;
+		if (optarg[4] != '\0' &&
+		    (sscanf(optarg, "libc,%lf", &libc_cap) != 1 || libc_cap <= 0)) {
+		    usage();
+		    exit(1);
+		}
+		run_libc = 1;
+	    }
+	    else
+		thru_cap = atof(optarg) * 1e3;
+	    if (thru_cap <= 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'w': /* Weight of util in the performance index */
+	    util_weight = atof(optarg);
+	    if (util_weight < 0 || util_weight > 1) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'B': /* Save a baseline of the results */
+	    save_file = strdup(optarg);
+	    num_samples = BASELINE_SAMPLES;
+	    break;
+	case 'C': /* Compare the results against a baseline: file[,tolerance] */
+	    compare_file = strdup(optarg);
+	    if ((p = strchr(compare_file, ',')) != NULL) {
+		tolerance = strtod(p + 1, &end);
+		if (end == p + 1 || *end != '\0' || tolerance < 0) {
+		    usage();
+		    exit(1);
+		}
+		*p = '\0';
+	    }
+	    num_samples = BASELINE_SAMPLES;
+	    break;
+	case 'o': /* Machine readable report: json|csv[,<file>] */
+	    if (!strncmp(optarg, "json", 4))
+		out_format = OUT_JSON;
+	    else if (!strncmp(optarg, "csv", 3))
+		out_format = OUT_CSV;
+	    else {
+		usage();
+		exit(1);
+	    }
+	    if (strchr(optarg, ',') != NULL)
+		out_file = strdup(strchr(optarg, ',') + 1);
+	    break;
+	case 's': /* Write a fragmentation timeline sampled every n ops */
+	    frag_every = strtol(optarg, &end, 10);
+	    frag_json = !strcmp(end, ",json");
+	    if (end == optarg || frag_every <= 0 || (*end != '\0' && !frag_json)) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'd': /* mm.c debug level and full check interval */
+	    debug_level = strtol(optarg, &end, 10);
+	    if (end != optarg && *end == ',')
+		debug_sweep = strtol(end + 1, &end, 10);
+	    if (end == optarg || *end != '\0' || debug_level < 0 || debug_sweep < 0) {
+		usage();
+		exit(1);
+	    }
+	    if (mm_set_debug(debug_level, debug_sweep) < 0)
+		printf("Warning: -d needs a debug build (make mdriver64-debug)\n");
+	    break;
+	case 'A': /* Evaluate this allocator variant, or "all" of them */
+	    variant_name = strdup(optarg);
+	    break;
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
 	    break;
@@ -199,6 +444,22 @@ int main(int argc, char **argv)
         }
     }
 	
+    /*
+     * The report gets stdout to itself if it goes there - everything
+     * else we print is moved over to stderr
+     */
+    if (out_format != OUT_NONE) {
+	if (out_file != NULL)
+	    out_fp = fopen(out_file, "w");
+	else {
+	    fflush(stdout);
+	    out_fp = fdopen(dup(STDOUT_FILENO), "w");
+	    dup2(STDERR_FILENO, STDOUT_FILENO);
+	}
+	if (out_fp == NULL)
+	    unix_error("Could not open the -o report");
+    }
+
     /* 
      * Check and print team info 
      */
@@ -269,7 +530,7 @@ int main(int argc, char **argv)
 		speed_params.trace = trace;
 		if (verbose > 1)
 		    printf("and performance.\n");
-		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+		time_trace(eval_libc_speed, &speed_params, &libc_stats[i]);
 	    }
 	    free_trace(trace);
 	}
@@ -279,98 +540,154 @@ int main(int argc, char **argv)
 	    printf("\nResults for libc malloc:\n");
 	    printresults(num_tracefiles, libc_stats);
 	}
+
+	/* Scale the throughput cap from what libc does on this host */
+	if (libc_cap > 0) {
+	    secs = ops = 0;
+	    for (i=0; i < num_tracefiles; i++) {
+		if (libc_stats[i].valid) {
+		    secs += libc_stats[i].secs;
+		    ops += libc_stats[i].ops;
+		}
+	    }
+	    if (secs > 0)
+		thru_cap = libc_cap * ops/secs;
+	    printf("Throughput cap = %.0f Kops (%.2f x libc)\n", 
+		   thru_cap/1e3, libc_cap);
+	}
+    }
+
+    /*
+     * Pick the allocator variant(s) to evaluate. By default this is 
+     * only the student's mm package (mm.c)
+     */
+    if (!strcmp(variant_name, "all")) {
+	for (num_variants = 0; mm_allocators[num_variants] != NULL; ) 
+	    num_variants++;
+    }
+    variants = (variant_t *)calloc(num_variants, sizeof(variant_t));
+    if (variants == NULL)
+	unix_error("variants calloc in main failed");
+    for (j = 0; j < num_variants; j++) {
+	if (!strcmp(variant_name, "all"))
+	    variants[j].allocator = mm_allocators[j];
+	else if ((variants[j].allocator = mm_find_allocator(variant_name)) == NULL) {
+	    printf("ERROR: Unknown allocator variant %s\n", variant_name);
+	    exit(1);
+	}
+
+	/* Allocate the stats array, with one stats_t struct per tracefile */
+	variants[j].stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+	if (variants[j].stats == NULL)
+	    unix_error("variant stats calloc in main failed");
     }
 
     /*
      * Always run and evaluate the student's mm package
      */
     if (verbose > 1)
-	printf("\nTesting mm malloc\n");
+	printf("\nTesting %s malloc\n", variant_name);
 
-    /* Allocate the mm stats array, with one stats_t struct per tracefile */
-    mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
-    if (mm_stats == NULL)
-	unix_error("mm_stats calloc in main failed");
-    
     /* Initialize the simulated memory system in memlib.c */
     mem_init(); 
 
-    /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i=0; i < num_tracefiles; i++) {
-	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
-	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-	}
-	free_trace(trace);
-    }
-
-    /* Display the mm results in a compact table */
-    if (verbose) {
-	printf("\nResults for mm malloc:\n");
-	printresults(num_tracefiles, mm_stats);
-	printf("\n");
-    }
-
     /* 
-     * Accumulate the aggregate statistics for the student's mm package 
+     * Evaluate each mm malloc package using the K-best scheme, trace 
+     * by trace or num_workers traces at a time
      */
-    secs = 0;
-    ops = 0;
-    util = 0;
-    numcorrect = 0;
-    for (i=0; i < num_tracefiles; i++) {
-	secs += mm_stats[i].secs;
-	ops += mm_stats[i].ops;
-	util += mm_stats[i].util;
-	if (mm_stats[i].valid)
-	    numcorrect++;
+    if (num_workers > 1)
+	eval_mm_parallel(tracefiles, num_tracefiles, variants, num_variants);
+    else {
+	for (i=0; i < num_tracefiles; i++)
+	    eval_mm_trace(tracefiles[i], i, variants, num_variants);
     }
-    avg_mm_util = util/num_tracefiles;
 
-    /* 
-     * Compute and print the performance index 
-     */
-    if (errors == 0) {
-	avg_mm_throughput = ops/secs;
+    for (j = 0; j < num_variants; j++) {
+	allocator = variants[j].allocator;
+	variant_stats = variants[j].stats;
+	errors = variants[j].errors;
 
-	p1 = UTIL_WEIGHT * avg_mm_util;
-	if (avg_mm_throughput > AVG_LIBC_THRUPUT) {
-	    p2 = (double)(1.0 - UTIL_WEIGHT);
-	} 
-	else {
-	    p2 = ((double) (1.0 - UTIL_WEIGHT)) * 
-		(avg_mm_throughput/AVG_LIBC_THRUPUT);
+	/* Display the mm results in a compact table */
+	if (verbose) {
+	    printf("\nResults for %s malloc:\n", allocator->name);
+	    printresults(num_tracefiles, variant_stats);
+	    printcounters(num_tracefiles, variant_stats);
+	    printf("\n");
 	}
+
+	/* 
+	 * Accumulate the aggregate statistics for the student's mm package 
+	 */
+	secs = 0;
+	ops = 0;
+	util = 0;
+	numcorrect = 0;
+	for (i=0; i < num_tracefiles; i++) {
+	    secs += variant_stats[i].secs;
+	    ops += variant_stats[i].ops;
+	    util += variant_stats[i].util;
+	    if (variant_stats[i].valid)
+		numcorrect++;
+	}
+	avg_mm_util = util/num_tracefiles;
+
+	/* 
+	 * Compute and print the performance index 
+	 */
+	if (num_variants > 1)
+	    printf("%s: ", allocator->name);
+	if (errors == 0) {
+	    avg_mm_throughput = ops/secs;
+
+	    p1 = util_weight * avg_mm_util;
+	    if (avg_mm_throughput > thru_cap) {
+		p2 = (double)(1.0 - util_weight);
+	    } 
+	    else {
+		p2 = ((double) (1.0 - util_weight)) * 
+		    (avg_mm_throughput/thru_cap);
+	    }
 	
-	perfindex = (p1 + p2)*100.0;
-	printf("Perf index = %.0f (util) + %.0f (thru) = %.0f/100\n",
-	       p1*100, 
-	       p2*100, 
-	       perfindex);
-	
-    }
-    else { /* There were errors */
-	perfindex = 0.0;
-	printf("Terminated with %d errors\n", errors);
+	    perfindex = (p1 + p2)*100.0;
+	    printf("Perf index = %.0f (util) + %.0f (thru) = %.0f/100\n",
+		   p1*100, 
+		   p2*100, 
+		   perfindex);
+
+	    /* The index stops at the cap, so show how far past it we are */
+	    if (num_variants > 1)
+		printf("%*s  ", (int)strlen(allocator->name), "");
+	    printf("Throughput = %.0f Kops (%.2f x the cap of %.0f Kops)\n",
+		   avg_mm_throughput/1e3, avg_mm_throughput/thru_cap, 
+		   thru_cap/1e3);
+	    variants[j].thruput = avg_mm_throughput;
+	}
+	else { /* There were errors */
+	    perfindex = 0.0;
+	    printf("Terminated with %d errors\n", errors);
+	}
+
+	if (autograder) {
+	    printf("correct:%d\n", numcorrect);
+	    printf("perfidx:%.0f\n", perfindex);
+	    printf("thruput:%.0f\n", variants[j].thruput);
+	}
+	variants[j].perfindex = perfindex;
     }
 
-    if (autograder) {
-	printf("correct:%d\n", numcorrect);
-	printf("perfidx:%.0f\n", perfindex);
+    if (out_format != OUT_NONE) {
+	printreport(tracefiles, num_tracefiles, variants, num_variants, libc_stats);
+	fclose(out_fp);
     }
 
-    exit(0);
+    /* Compare against the old baseline before writing a new one */
+    if (compare_file != NULL)
+	regressions = compare_baseline(compare_file, tolerance, tracefiles, 
+				       num_tracefiles, variants, num_variants);
+    if (save_file != NULL)
+	save_baseline(save_file, tracefiles, num_tracefiles, variants, num_variants);
+
+    exit(regressions ? 2 : 0);
 }
 
 
@@ -485,9 +802,15 @@ static trace_t *read_trace(char *tracedir, char *filename)
     trace_t *trace;
     char type[MAXLINE];
     char path[MAXLINE];
-    unsigned index, size;
+    unsigned index, size, alignment, count;
     unsigned max_index = 0;
     unsigned op_index;
+    unsigned *cur_sizes; /* current payload size of each id, for free ops */
+    unsigned scope;
+    int *open_scopes;    /* stack of the ARENA_BEGIN ops of open scopes */
+    int depth = 0;       /* number of open scopes */
+    int *id_scope;       /* ARENA_BEGIN op of the scope each live id is in, or -1 */
+    int i, n;
 
     if (verbose > 1)
 	printf("Reading tracefile: %s\n", filename);
@@ -522,6 +845,18 @@ static trace_t *read_trace(char *tracedir, char *filename)
     if ((trace->block_sizes = 
 	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
 	unix_error("malloc 4 failed in read_trace");
+
+    if ((cur_sizes = 
+	 (unsigned *)calloc(trace->num_ids, sizeof(unsigned))) == NULL)
+	unix_error("malloc 5 failed in read_trace");
+
+    /* Arena scope bookkeeping */
+    if ((open_scopes = (int *)malloc(trace->num_ops * sizeof(int))) == NULL ||
+	(id_scope = (int *)malloc(trace->num_ids * sizeof(int))) == NULL)
+	unix_error("malloc 6 failed in read_trace");
+    for (i = 0; i < trace->num_ids; i++)
+	id_scope[i] = -1;
+    trace->num_scopes = 0;
     
     /* read every request line in the trace file */
     index = 0;
@@ -533,19 +868,112 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	    trace->ops[op_index].type = ALLOC;
 	    trace->ops[op_index].index = index;
 	    trace->ops[op_index].size = size;
+	    cur_sizes[index] = size;
 	    max_index = (index > max_index) ? index : max_index;
+
+	    /* Inside a scope the block comes from the innermost arena */
+	    if (depth > 0) {
+		trace->ops[op_index].type = ARENA_ALLOC;
+		trace->ops[op_index].scope = trace->ops[open_scopes[depth-1]].scope;
+		id_scope[index] = open_scopes[depth-1];
+	    }
 	    break;
 	case 'r':
 	    fscanf(tracefile, "%u %u", &index, &size);
+	    if (id_scope[index] != -1) {
+		printf("Realloc of arena block %u in tracefile %s\n", index, path);
+		exit(1);
+	    }
 	    trace->ops[op_index].type = REALLOC;
 	    trace->ops[op_index].index = index;
 	    trace->ops[op_index].size = size;
+	    cur_sizes[index] = size;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'm': /* m <index> <alignment> <size> */
+	    fscanf(tracefile, "%u %u %u", &index, &alignment, &size);
+	    if (alignment == 0 || (alignment & (alignment - 1))) {
+		printf("m %u has alignment %u, not a power of two, in tracefile %s\n",
+		       index, alignment, path);
+		exit(1);
+	    }
+	    trace->ops[op_index].type = MEMALIGN;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].alignment = alignment;
+	    trace->ops[op_index].size = size;
+	    cur_sizes[index] = size;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'c': /* c <index> <size> */
+	    fscanf(tracefile, "%u %u", &index, &size);
+	    trace->ops[op_index].type = CALLOC;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    cur_sizes[index] = size;
 	    max_index = (index > max_index) ? index : max_index;
 	    break;
 	case 'f':
 	    fscanf(tracefile, "%ud", &index);
 	    trace->ops[op_index].type = FREE;
 	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = cur_sizes[index];
+	    if (id_scope[index] != -1) {
+		trace->ops[op_index].type = ARENA_FREE;
+		trace->ops[op_index].scope = trace->ops[id_scope[index]].scope;
+		id_scope[index] = -1;
+	    }
+	    break;
+	case 'S': /* S <scope> - "a" requests up to E <scope> use an arena */
+	    fscanf(tracefile, "%u", &scope);
+	    trace->ops[op_index].type = ARENA_BEGIN;
+	    trace->ops[op_index].scope = scope;
+	    if (scope >= trace->num_scopes)
+		trace->num_scopes = scope + 1;
+	    open_scopes[depth++] = op_index;
+	    break;
+	case 'E': /* E <scope> - drop everything still live in the scope */
+	    fscanf(tracefile, "%u", &scope);
+	    if (depth == 0 || trace->ops[open_scopes[depth-1]].scope != scope) {
+		printf("E %u does not close the innermost scope in tracefile %s\n",
+		       scope, path);
+		exit(1);
+	    }
+	    depth--;
+	    trace->ops[op_index].type = ARENA_END;
+	    trace->ops[op_index].scope = scope;
+
+	    /* Remember which ids the scope releases */
+	    for (i = n = 0; i < trace->num_ids; i++)
+		n += (id_scope[i] == open_scopes[depth]);
+	    trace->ops[op_index].count = n;
+	    trace->ops[op_index].ids = NULL; /* an empty scope releases none */
+	    if (n > 0 &&
+		(trace->ops[op_index].ids = (int *)malloc(n * sizeof(int))) == NULL)
+		unix_error("malloc 7 failed in read_trace");
+	    for (i = n = 0; i < trace->num_ids; i++) {
+		if (id_scope[i] == open_scopes[depth]) {
+		    trace->ops[op_index].ids[n++] = i;
+		    id_scope[i] = -1;
+		}
+	    }
+	    break;
+	case 'A': /* A <first index> <count> <size> */
+	    fscanf(tracefile, "%u %u %u", &index, &count, &size);
+	    assert(count > 0);
+	    trace->ops[op_index].type = ALLOC_BATCH;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].count = count;
+	    trace->ops[op_index].size = size;
+	    while (count-- > 0)
+		cur_sizes[index++] = size;
+	    index--;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'F': /* F <first index> <count> */
+	    fscanf(tracefile, "%u %u", &index, &count);
+	    trace->ops[op_index].type = FREE_BATCH;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].count = count;
 	    break;
 	default:
 	    printf("Bogus type character (%c) in tracefile %s\n", 
@@ -556,6 +984,14 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	
     }
     fclose(tracefile);
+    free(cur_sizes);
+    free(open_scopes);
+    free(id_scope);
+    assert(depth == 0);
+
+    if ((trace->arenas = (mm_arena_t **)
+	 calloc(trace->num_scopes + 1, sizeof(mm_arena_t *))) == NULL)
+	unix_error("malloc 8 failed in read_trace");
     assert(max_index == trace->num_ids - 1);
     assert(trace->num_ops == op_index);
     
@@ -563,11 +999,18 @@ static trace_t *read_trace(char *tracedir, char *filename)
 }
 
 /*
- * free_trace - Free the trace record and the three arrays it points
+ * free_trace - Free the trace record and the arrays it points
  *              to, all of which were allocated in read_trace().
  */
 void free_trace(trace_t *trace)
 {
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++) {
+	if (trace->ops[i].type == ARENA_END)
+	    free(trace->ops[i].ids);
+    }
+    free(trace->arenas);
     free(trace->ops);         /* free the three arrays... */
     free(trace->blocks);      
     free(trace->block_sizes);
@@ -587,17 +1030,20 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     int i, j;
     int index;
     int size;
+    int count;
     int oldsize;
     char *newp;
     char *oldp;
     char *p;
     
-    /* Reset the heap and free any records in the range list */
+    /* Reset the heap (and with it any arenas) and free any records
+     * in the range list */
     mem_reset_brk();
+    memset(trace->arenas, 0, trace->num_scopes * sizeof(mm_arena_t *));
     clear_ranges(ranges);
 
     /* Call the mm package's init function */
-    if (mm_init() < 0) {
+    if (allocator->init() < 0) {
 	malloc_error(tracenum, 0, "mm_init failed.");
 	return 0;
     }
@@ -612,7 +1058,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
         case ALLOC: /* mm_malloc */
 
 	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
+	    if ((p = allocator->malloc(size)) == NULL) {
 		malloc_error(tracenum, i, "mm_malloc failed.");
 		return 0;
 	    }
@@ -630,7 +1076,58 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	     * if we realloc the block and wish to make sure that the old
 	     * data was copied to the new block
 	     */
-	    memset(p, index & 0xFF, size);
+	    fill_payload(p, size, index);
+
+	    /* Remember region */
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
+        case MEMALIGN: /* mm_memalign */
+
+	    /* Call the student's memalign */
+	    if (allocator->memalign == NULL) {
+		malloc_error(tracenum, i, "allocator has no mm_memalign.");
+		return 0;
+	    }
+	    if ((p = allocator->memalign(trace->ops[i].alignment, size)) == NULL) {
+		malloc_error(tracenum, i, "mm_memalign failed.");
+		return 0;
+	    }
+
+	    /* The block must be aligned as requested, and pass the
+	     * same checks as any other block */
+	    if (((size_t)p) % trace->ops[i].alignment) {
+		sprintf(msg, "Payload address (%p) not aligned to %d bytes",
+			p, trace->ops[i].alignment);
+		malloc_error(tracenum, i, msg);
+		return 0;
+	    }
+	    if (add_range(ranges, p, size, tracenum, i) == 0)
+		return 0;
+	    fill_payload(p, size, index);
+
+	    /* Remember region */
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
+        case CALLOC: /* mm_calloc */
+
+	    /* Call the student's calloc */
+	    if ((p = mm_calloc_or_emulate(size)) == NULL) {
+		malloc_error(tracenum, i, "mm_calloc failed.");
+		return 0;
+	    }
+	    if (add_range(ranges, p, size, tracenum, i) == 0)
+		return 0;
+
+	    /* The payload must come back cleared */
+	    if (!payload_ok(p, index, size, size, 0)) {
+		malloc_error(tracenum, i, "mm_calloc did not zero the block");
+		return 0;
+	    }
+	    fill_payload(p, size, index);
 
 	    /* Remember region */
 	    trace->blocks[index] = p;
@@ -641,7 +1138,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    /* Call the student's realloc */
 	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp, size)) == NULL) {
+	    if ((newp = allocator->realloc(oldp, size)) == NULL) {
 		malloc_error(tracenum, i, "mm_realloc failed.");
 		return 0;
 	    }
@@ -659,15 +1156,12 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	     * of the new index
 	     */
 	    oldsize = trace->block_sizes[index];
-	    if (size < oldsize) oldsize = size;
-	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	    if (!payload_ok(newp, index, oldsize, size, index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
-	      }
 	    }
-	    memset(newp, index & 0xFF, size);
+	    fill_payload(newp, size, index);
 
 	    /* Remember region */
 	    trace->blocks[index] = newp;
@@ -679,7 +1173,70 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Remove region from list and call student's free function */
 	    p = trace->blocks[index];
 	    remove_range(ranges, p);
-	    mm_free(p);
+	    mm_free_sized_or_emulate(p, size);
+	    break;
+
+        case ALLOC_BATCH: /* mm_malloc_batch */
+
+	    /* Call the student's batch malloc, which stores the blocks
+	     * for ids index..index+count-1 straight into trace->blocks */
+	    count = trace->ops[i].count;
+	    if (mm_malloc_batch_or_emulate(size, count, 
+					   &trace->blocks[index]) != count) {
+		malloc_error(tracenum, i, "mm_malloc_batch failed.");
+		return 0;
+	    }
+
+	    /* Each block must pass the same checks as any other block */
+	    for (j = 0; j < count; j++) {
+		p = trace->blocks[index + j];
+		if (add_range(ranges, p, size, tracenum, i) == 0)
+		    return 0;
+		fill_payload(p, size, index + j);
+		trace->block_sizes[index + j] = size;
+	    }
+	    break;
+
+        case FREE_BATCH: /* mm_free_batch */
+
+	    /* Remove the regions from the list and free them in one call */
+	    count = trace->ops[i].count;
+	    for (j = 0; j < count; j++)
+		remove_range(ranges, trace->blocks[index + j]);
+	    mm_free_batch_or_emulate(&trace->blocks[index], count);
+	    break;
+
+        case ARENA_BEGIN: /* mm_arena_create */
+	    if (!arena_begin(trace, trace->ops[i].scope)) {
+		malloc_error(tracenum, i, "mm_arena_create failed.");
+		return 0;
+	    }
+	    break;
+
+        case ARENA_ALLOC: /* mm_arena_alloc */
+	    if ((p = arena_alloc_or_emulate(trace, trace->ops[i].scope, size)) == NULL) {
+		malloc_error(tracenum, i, "mm_arena_alloc failed.");
+		return 0;
+	    }
+	    if (add_range(ranges, p, size, tracenum, i) == 0)
+		return 0;
+	    fill_payload(p, size, index);
+
+	    /* Remember region */
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
+        case ARENA_FREE: /* nothing until the scope ends */
+	    p = trace->blocks[index];
+	    remove_range(ranges, p);
+	    arena_free_or_emulate(p);
+	    break;
+
+        case ARENA_END: /* mm_arena_reset */
+	    for (j = 0; j < trace->ops[i].count; j++)
+		remove_range(ranges, trace->blocks[trace->ops[i].ids[j]]);
+	    arena_end_or_emulate(trace, &trace->ops[i]);
 	    break;
 
 	default:
@@ -688,6 +1245,8 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 
     }
 
+    arena_destroy_all(trace);
+
     /* As far as we know, this is a valid malloc package */
     return 1;
 }
@@ -705,17 +1264,18 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 {   
-    int i;
-    int index;
+    int i, j;
+    int index, count;
     int size, newsize, oldsize;
     int max_total_size = 0;
     int total_size = 0;
     char *p;
     char *newp, *oldp;
 
-    /* initialize the heap and the mm malloc package */
+    /* initialize the heap, dropping any arenas, and the mm malloc package */
     mem_reset_brk();
-    if (mm_init() < 0)
+    memset(trace->arenas, 0, trace->num_scopes * sizeof(mm_arena_t *));
+    if (allocator->init() < 0)
 	app_error("mm_init failed in eval_mm_util");
 
     for (i = 0;  i < trace->num_ops;  i++) {
@@ -725,7 +1285,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if ((p = allocator->malloc(size)) == NULL) 
 		app_error("mm_malloc failed in eval_mm_util");
 	    
 	    /* Remember region and size */
@@ -741,13 +1301,53 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 		total_size : max_total_size;
 	    break;
 
+        case MEMALIGN: /* mm_memalign */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+
+	    if ((p = allocator->memalign(trace->ops[i].alignment, size)) == NULL) 
+		app_error("mm_memalign failed in eval_mm_util");
+	    
+	    /* Remember region and size */
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size += size;
+	    
+	    /* Update statistics */
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
+        case CALLOC: /* mm_calloc */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+
+	    if ((p = mm_calloc_or_emulate(size)) == NULL) 
+		app_error("mm_calloc failed in eval_mm_util");
+	    
+	    /* Remember region and size */
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size += size;
+	    
+	    /* Update statistics */
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
 	case REALLOC: /* mm_realloc */
 	    index = trace->ops[i].index;
 	    newsize = trace->ops[i].size;
 	    oldsize = trace->block_sizes[index];
 
 	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp,newsize)) == NULL)
+	    if ((newp = allocator->realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc failed in eval_mm_util");
 
 	    /* Remember region and size */
@@ -768,7 +1368,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    size = trace->block_sizes[index];
 	    p = trace->blocks[index];
 	    
-	    mm_free(p);
+	    mm_free_sized_or_emulate(p, size);
 	    
 	    /* Keep track of current total size
 	     * of all allocated blocks */
@@ -776,11 +1376,83 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    break;
 
+        case ALLOC_BATCH: /* mm_malloc_batch */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    count = trace->ops[i].count;
+
+	    if (mm_malloc_batch_or_emulate(size, count, 
+					   &trace->blocks[index]) != count) 
+		app_error("mm_malloc_batch failed in eval_mm_util");
+	    for (j = 0; j < count; j++)
+		trace->block_sizes[index + j] = size;
+
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size += count * size;
+	    
+	    /* Update statistics */
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
+        case FREE_BATCH: /* mm_free_batch */
+	    index = trace->ops[i].index;
+	    count = trace->ops[i].count;
+
+	    for (j = 0; j < count; j++)
+		total_size -= trace->block_sizes[index + j];
+	    mm_free_batch_or_emulate(&trace->blocks[index], count);
+	    break;
+
+        case ARENA_BEGIN: /* mm_arena_create */
+	    if (!arena_begin(trace, trace->ops[i].scope))
+		app_error("mm_arena_create failed in eval_mm_util");
+	    break;
+
+        case ARENA_ALLOC: /* mm_arena_alloc */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+
+	    if ((p = arena_alloc_or_emulate(trace, trace->ops[i].scope, size)) == NULL)
+		app_error("mm_arena_alloc failed in eval_mm_util");
+	    
+	    /* Remember region and size */
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size += size;
+	    
+	    /* Update statistics */
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
+        case ARENA_FREE: /* nothing until the scope ends */
+	    index = trace->ops[i].index;
+	    total_size -= trace->block_sizes[index];
+	    arena_free_or_emulate(trace->blocks[index]);
+	    break;
+
+        case ARENA_END: /* mm_arena_reset */
+	    for (j = 0; j < trace->ops[i].count; j++)
+		total_size -= trace->block_sizes[trace->ops[i].ids[j]];
+	    arena_end_or_emulate(trace, &trace->ops[i]);
+	    break;
+
 	default:
 	    app_error("Nonexistent request type in eval_mm_util");
 
         }
+
+	/* Record the heap layout for the fragmentation timeline */
+	if (frag_fp != NULL && 
+	    ((i + 1) % frag_every == 0 || i + 1 == trace->num_ops))
+	    frag_sample(i + 1, total_size);
     }
+    arena_destroy_all(trace);
 
     return ((double)max_total_size / (double)mem_heapsize());
 }
@@ -796,9 +1468,10 @@ static void eval_mm_speed(void *ptr)
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
-    /* Reset the heap and initialize the mm package */
+    /* Reset the heap, dropping any arenas, and initialize the mm package */
     mem_reset_brk();
-    if (mm_init() < 0) 
+    memset(trace->arenas, 0, trace->num_scopes * sizeof(mm_arena_t *));
+    if (allocator->init() < 0) 
 	app_error("mm_init failed in eval_mm_speed");
 
     /* Interpret each trace request */
@@ -808,29 +1481,516 @@ static void eval_mm_speed(void *ptr)
         case ALLOC: /* mm_malloc */
             index = trace->ops[i].index;
             size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            if ((p = allocator->malloc(size)) == NULL)
 		app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
             break;
 
-	case REALLOC: /* mm_realloc */
-	    index = trace->ops[i].index;
-            newsize = trace->ops[i].size;
-	    oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL)
-		app_error("mm_realloc error in eval_mm_speed");
-            trace->blocks[index] = newp;
+        case MEMALIGN: /* mm_memalign */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = allocator->memalign(trace->ops[i].alignment, size)) == NULL)
+		app_error("mm_memalign error in eval_mm_speed");
+            trace->blocks[index] = p;
+            break;
+
+        case CALLOC: /* mm_calloc */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = mm_calloc_or_emulate(size)) == NULL)
+		app_error("mm_calloc error in eval_mm_speed");
+            trace->blocks[index] = p;
+            break;
+
+	case REALLOC: /* mm_realloc */
+	    index = trace->ops[i].index;
+            newsize = trace->ops[i].size;
+	    oldp = trace->blocks[index];
+            if ((newp = allocator->realloc(oldp,newsize)) == NULL)
+		app_error("mm_realloc error in eval_mm_speed");
+            trace->blocks[index] = newp;
             break;
 
         case FREE: /* mm_free */
             index = trace->ops[i].index;
             block = trace->blocks[index];
-            mm_free(block);
+            mm_free_sized_or_emulate(block, trace->ops[i].size);
+            break;
+
+        case ALLOC_BATCH: /* mm_malloc_batch */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if (mm_malloc_batch_or_emulate(size, trace->ops[i].count, 
+					   &trace->blocks[index]) != trace->ops[i].count)
+		app_error("mm_malloc_batch error in eval_mm_speed");
+            break;
+
+        case FREE_BATCH: /* mm_free_batch */
+            index = trace->ops[i].index;
+            mm_free_batch_or_emulate(&trace->blocks[index], trace->ops[i].count);
+            break;
+
+        case ARENA_BEGIN: /* mm_arena_create */
+            if (!arena_begin(trace, trace->ops[i].scope))
+		app_error("mm_arena_create error in eval_mm_speed");
+            break;
+
+        case ARENA_ALLOC: /* mm_arena_alloc */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = arena_alloc_or_emulate(trace, trace->ops[i].scope, size)) == NULL)
+		app_error("mm_arena_alloc error in eval_mm_speed");
+            trace->blocks[index] = p;
+            break;
+
+        case ARENA_FREE: /* nothing until the scope ends */
+            arena_free_or_emulate(trace->blocks[trace->ops[i].index]);
+            break;
+
+        case ARENA_END: /* mm_arena_reset */
+            arena_end_or_emulate(trace, &trace->ops[i]);
             break;
 
 	default:
 	    app_error("Nonexistent request type in eval_mm_valid");
         }
+    arena_destroy_all(trace);
+}
+
+/*
+ * eval_mm_trace - Evaluate every variant on trace tracenum, read from
+ *     tracefile. Every variant runs on the same loaded copy of the trace.
+ */
+static void eval_mm_trace(char *tracefile, int tracenum, 
+			  variant_t *variants, int num_variants)
+{
+    int j;
+    trace_t *trace;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+    stats_t *stats;
+    char token;
+
+    trace = read_trace(tracedir, tracefile);
+    for (j = 0; j < num_variants; j++) {
+	allocator = variants[j].allocator;
+	stats = &variants[j].stats[tracenum];
+	errors = variants[j].errors;
+
+	stats->ops = trace->num_ops;
+	if (verbose > 1)
+	    printf("Checking %s_malloc for correctness, ", allocator->name);
+	stats->valid = eval_mm_valid(trace, tracenum, &ranges);
+	if (stats->valid) {
+	    if (verbose > 1)
+		printf("efficiency, ");
+	    frag_open(tracefile);
+	    stats->util = eval_mm_util(trace, tracenum, &ranges);
+	    stats->heap = mem_heapsize();
+	    stats->counted = (allocator->stats != NULL && 
+			      allocator->stats(&stats->counters) == 0);
+	    frag_close();
+	    speed_params.trace = trace;
+	    speed_params.ranges = ranges;
+	    if (verbose > 1)
+		printf("and performance.\n");
+
+	    /* With -j n,serial only the worker holding the token times */
+	    if (timing_token[0] >= 0 && read(timing_token[0], &token, 1) != 1)
+		unix_error("timing token read failed");
+	    time_trace(eval_mm_speed, &speed_params, stats);
+	    if (timing_token[1] >= 0 && write(timing_token[1], &token, 1) != 1)
+		unix_error("timing token write failed");
+	}
+	variants[j].errors = errors;
+    }
+    free_trace(trace);
+}
+
+/*
+ * eval_mm_parallel - Evaluate the n traces in up to num_workers child 
+ *     processes at once, each pinned to its own CPU and with its own 
+ *     copy of the memlib heap. A worker sends the stats and the number 
+ *     of errors of each variant back through a pipe. A worker that dies 
+ *     leaves its trace invalid and counts as an error.
+ */
+static void eval_mm_parallel(char **tracefiles, int n, 
+			     variant_t *variants, int num_variants)
+{
+    int i, j, k, slot, status, num_cpus, running = 0;
+    int *slot_trace, *slot_fd, worker_errors;
+    pid_t pid, *slot_pid;
+    int fd[2];
+    cpu_set_t cpus;
+    stats_t stats;
+
+    slot_pid = (pid_t *)calloc(num_workers, sizeof(pid_t));
+    slot_trace = (int *)calloc(num_workers, sizeof(int));
+    slot_fd = (int *)calloc(num_workers, sizeof(int));
+    if (slot_pid == NULL || slot_trace == NULL || slot_fd == NULL)
+	unix_error("worker calloc in eval_mm_parallel failed");
+    num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    fflush(stdout);
+
+    for (i = 0; i < n || running > 0; ) {
+	/* Start a worker for the next trace if a slot is free */
+	if (i < n && running < num_workers) {
+	    for (slot = 0; slot_pid[slot] != 0; slot++)
+		;
+	    if (pipe(fd) < 0)
+		unix_error("worker pipe in eval_mm_parallel failed");
+	    if ((pid = fork()) < 0)
+		unix_error("fork in eval_mm_parallel failed");
+	    if (pid == 0) {
+		close(fd[0]);
+		CPU_ZERO(&cpus);
+		CPU_SET(slot % num_cpus, &cpus);
+		sched_setaffinity(0, sizeof(cpus), &cpus);
+		for (j = 0; j < num_variants; j++)
+		    variants[j].errors = 0;
+		eval_mm_trace(tracefiles[i], i, variants, num_variants);
+		for (j = 0; j < num_variants; j++) {
+		    if (write(fd[1], &variants[j].stats[i], sizeof(stats_t)) 
+			!= sizeof(stats_t) ||
+			write(fd[1], &variants[j].errors, sizeof(int)) != sizeof(int))
+			_exit(1);
+		}
+		fflush(stdout);
+		_exit(0);
+	    }
+	    close(fd[1]);
+	    slot_pid[slot] = pid;
+	    slot_trace[slot] = i++;
+	    slot_fd[slot] = fd[0];
+	    running++;
+	    continue;
+	}
+
+	/* Otherwise collect the results of the next worker to finish */
+	if ((pid = wait(&status)) < 0)
+	    unix_error("wait in eval_mm_parallel failed");
+	for (slot = 0; slot < num_workers && slot_pid[slot] != pid; slot++)
+	    ;
+	if (slot == num_workers)
+	    continue;
+	k = slot_trace[slot];
+	for (j = 0; j < num_variants; j++) {
+	    if (read(slot_fd[slot], &stats, sizeof(stats_t)) != sizeof(stats_t) ||
+		read(slot_fd[slot], &worker_errors, sizeof(int)) != sizeof(int)) {
+		printf("ERROR: the worker for %s died (status %d)\n", 
+		       tracefiles[k], status);
+		for ( ; j < num_variants; j++) {
+		    variants[j].stats[k].valid = 0;
+		    variants[j].errors++;
+		}
+		break;
+	    }
+	    variants[j].stats[k] = stats;
+	    variants[j].errors += worker_errors;
+	}
+	close(slot_fd[slot]);
+	slot_pid[slot] = 0;
+	running--;
+    }
+
+    free(slot_pid);
+    free(slot_trace);
+    free(slot_fd);
+}
+
+/*
+ * fill_payload - Fill the payload of block id with the low byte of id,
+ *     as much of it as the -m mode checks
+ */
+static void fill_payload(char *p, int size, int id)
+{
+    if (check_mode == CHECK_OFF)
+	return;
+    if (check_mode == CHECK_FULL || id % check_every == 0 || 
+	size <= 2 * check_edge) {
+	memset(p, id & 0xFF, size);
+	return;
+    }
+    memset(p, id & 0xFF, check_edge);
+    memset(p + size - check_edge, id & 0xFF, check_edge);
+}
+
+/*
+ * payload_ok - Return true if the first len bytes of the payload of block
+ *     id hold byte, where fill_payload filled them. filled is the size 
+ *     the block was filled with.
+ */
+static int payload_ok(char *p, int id, int filled, int len, int byte)
+{
+    int j, sampled;
+
+    if (check_mode == CHECK_OFF)
+	return 1;
+    sampled = (check_mode == CHECK_SAMPLE && id % check_every != 0 && 
+	       filled > 2 * check_edge);
+
+    /* The prefix (or everything), then the suffix */
+    for (j = 0; j < (sampled ? check_edge : filled) && j < len; j++)
+	if (p[j] != (char)byte)
+	    return 0;
+    if (sampled) {
+	for (j = filled - check_edge; j < filled && j < len; j++)
+	    if (p[j] != (char)byte)
+		return 0;
+    }
+    return 1;
+}
+
+/*
+ * mm_calloc_or_emulate - Allocate a cleared block of size bytes with the 
+ *    package's calloc, or with malloc and memset if it has none
+ */
+static void *mm_calloc_or_emulate(size_t size)
+{
+    void *p;
+
+    if (allocator->calloc != NULL)
+	return allocator->calloc(1, size);
+    if ((p = allocator->malloc(size)) != NULL)
+	memset(p, 0, size);
+    return p;
+}
+
+/*
+ * mm_malloc_batch_or_emulate - Allocate n blocks of size bytes into ptrs
+ *    with the package's batch malloc, or one at a time if it has none.
+ *    Returns the number of blocks allocated.
+ */
+static size_t mm_malloc_batch_or_emulate(size_t size, size_t n, char **ptrs)
+{
+    size_t i;
+
+    if (allocator->malloc_batch != NULL)
+	return allocator->malloc_batch(size, n, (void **)ptrs);
+    for (i = 0; i < n; i++) {
+	if ((ptrs[i] = allocator->malloc(size)) == NULL)
+	    break;
+    }
+    return i;
+}
+
+/*
+ * mm_free_batch_or_emulate - Free the n blocks in ptrs with the package's
+ *    batch free, or one at a time if it has none. ptrs may be reordered.
+ */
+static void mm_free_batch_or_emulate(char **ptrs, size_t n)
+{
+    size_t i;
+
+    if (allocator->free_batch != NULL) {
+	allocator->free_batch((void **)ptrs, n);
+	return;
+    }
+    for (i = 0; i < n; i++)
+	allocator->free(ptrs[i]);
+}
+
+/*
+ * mm_free_sized_or_emulate - Free ptr, whose payload is size bytes, with
+ *    the package's sized free, or with its plain free if it has none
+ */
+static void mm_free_sized_or_emulate(void *ptr, size_t size)
+{
+    if (allocator->free_sized != NULL)
+	allocator->free_sized(ptr, size);
+    else
+	allocator->free(ptr);
+}
+
+/*
+ * arena_begin - Make sure scope has an arena, if the package has them.
+ *    Returns 0 if the arena could not be created.
+ */
+static int arena_begin(trace_t *trace, int scope)
+{
+    if (allocator->arena_create != NULL && trace->arenas[scope] == NULL)
+	trace->arenas[scope] = allocator->arena_create();
+    return allocator->arena_create == NULL || trace->arenas[scope] != NULL;
+}
+
+/*
+ * arena_alloc_or_emulate - Allocate size bytes in the arena of scope, or
+ *    with the package's malloc if it has no arenas
+ */
+static void *arena_alloc_or_emulate(trace_t *trace, int scope, size_t size)
+{
+    if (allocator->arena_alloc != NULL)
+	return allocator->arena_alloc(trace->arenas[scope], size);
+    return allocator->malloc(size);
+}
+
+/*
+ * arena_free_or_emulate - A free of a block in a scope. Arena blocks 
+ *    stay until the scope ends, emulated ones are freed right away.
+ */
+static void arena_free_or_emulate(void *ptr)
+{
+    if (allocator->arena_alloc == NULL)
+	allocator->free(ptr);
+}
+
+/*
+ * arena_end_or_emulate - End the scope of op by resetting its arena, or
+ *    by freeing the blocks still live in it if the package has no arenas
+ */
+static void arena_end_or_emulate(trace_t *trace, traceop_t *op)
+{
+    int i;
+
+    if (allocator->arena_reset != NULL) {
+	allocator->arena_reset(trace->arenas[op->scope]);
+	return;
+    }
+    for (i = 0; i < op->count; i++)
+	allocator->free(trace->blocks[op->ids[i]]);
+}
+
+/*
+ * arena_destroy_all - Destroy the arenas created while evaluating a trace
+ */
+static void arena_destroy_all(trace_t *trace)
+{
+    int i;
+
+    for (i = 0; i < trace->num_scopes; i++) {
+	if (trace->arenas[i] != NULL)
+	    allocator->arena_destroy(trace->arenas[i]);
+	trace->arenas[i] = NULL;
+    }
+}
+
+/*
+ * frag_open - Start the fragmentation timeline of tracefile for the
+ *    current variant, if one was asked for and the variant can walk
+ *    its heap
+ */
+static void frag_open(char *tracefile)
+{
+    char path[MAXLINE];
+    char *base;
+    int i;
+
+    frag_fp = NULL;
+    if (frag_every <= 0)
+	return;
+    if (allocator->heap_walk == NULL) {
+	if (verbose)
+	    printf("%s cannot walk its heap, no fragmentation timeline\n", 
+		   allocator->name);
+	return;
+    }
+
+    /* <trace name without directory and .rep>.<variant>.frag.csv */
+    base = strrchr(tracefile, '/') ? strrchr(tracefile, '/') + 1 : tracefile;
+    strcpy(path, base);
+    if (strstr(path, ".rep") != NULL)
+	*strstr(path, ".rep") = '\0';
+    sprintf(path + strlen(path), ".%s.frag.%s", allocator->name, 
+	    frag_json ? "json" : "csv");
+    if ((frag_fp = fopen(path, "w")) == NULL) {
+	sprintf(msg, "Could not open %s in frag_open", path);
+	unix_error(msg);
+    }
+
+    frag_rows = 0;
+    if (frag_json) {
+	fprintf(frag_fp, "{\"trace\": \"%s\", \"allocator\": \"%s\", "
+		"\"every\": %d, \"hist_min\": 16,\n \"samples\": [", 
+		base, allocator->name, frag_every);
+    } else {
+	fprintf(frag_fp, "op,heap,live,alloc_blocks,alloc_bytes,internal,tags,"
+		"free_blocks,free_bytes,largest_free,other");
+	for (i = 0; i < FRAG_BUCKETS; i++)
+	    fprintf(frag_fp, ",free_%lu", 16UL << i);
+	fprintf(frag_fp, "\n");
+    }
+}
+
+/*
+ * frag_walk - Heap walk callback that adds one block to a frag_t
+ */
+static void frag_walk(void *bp, size_t size, size_t usable, int alloc, void *arg)
+{
+    frag_t *f = (frag_t *)arg;
+    int i;
+
+    if (alloc) {
+	f->alloc_blocks++;
+	f->alloc_bytes += size;
+	f->usable_bytes += usable;
+	return;
+    }
+    f->free_blocks++;
+    f->free_bytes += size;
+    if (size > f->largest_free)
+	f->largest_free = size;
+    for (i = 0; i < FRAG_BUCKETS - 1 && size >= (32UL << i); i++)
+	;
+    f->hist[i]++;
+}
+
+/*
+ * frag_sample - Walk the heap after op ops with live bytes of payload
+ *    requested, and write one sample. The heap is split into what the
+ *    requests use, internal padding, boundary tags, free blocks and
+ *    whatever else the allocator keeps (prologue, epilogue, ...).
+ */
+static void frag_sample(int op, int live)
+{
+    frag_t f;
+    size_t heap = mem_heapsize();
+    int i;
+
+    memset(&f, 0, sizeof(f));
+    allocator->heap_walk(frag_walk, &f);
+
+    if (frag_json) {
+	fprintf(frag_fp, "%s\n  {\"op\": %d, \"heap\": %lu, \"live\": %d, "
+		"\"alloc_blocks\": %lu, \"alloc_bytes\": %lu, \"internal\": %ld, "
+		"\"tags\": %lu, \"free_blocks\": %lu, \"free_bytes\": %lu, "
+		"\"largest_free\": %lu, \"other\": %ld, \"free_hist\": [",
+		frag_rows ? "," : "", op, (unsigned long)heap, live, 
+		(unsigned long)f.alloc_blocks, (unsigned long)f.alloc_bytes, 
+		(long)f.usable_bytes - live, 
+		(unsigned long)(f.alloc_bytes - f.usable_bytes),
+		(unsigned long)f.free_blocks, (unsigned long)f.free_bytes, 
+		(unsigned long)f.largest_free,
+		(long)(heap - f.alloc_bytes - f.free_bytes));
+	for (i = 0; i < FRAG_BUCKETS; i++)
+	    fprintf(frag_fp, "%s%lu", i ? ", " : "", (unsigned long)f.hist[i]);
+	fprintf(frag_fp, "]}");
+    } else {
+	fprintf(frag_fp, "%d,%lu,%d,%lu,%lu,%ld,%lu,%lu,%lu,%lu,%ld", 
+		op, (unsigned long)heap, live, 
+		(unsigned long)f.alloc_blocks, (unsigned long)f.alloc_bytes, 
+		(long)f.usable_bytes - live, 
+		(unsigned long)(f.alloc_bytes - f.usable_bytes),
+		(unsigned long)f.free_blocks, (unsigned long)f.free_bytes, 
+		(unsigned long)f.largest_free,
+		(long)(heap - f.alloc_bytes - f.free_bytes));
+	for (i = 0; i < FRAG_BUCKETS; i++)
+	    fprintf(frag_fp, ",%lu", (unsigned long)f.hist[i]);
+	fprintf(frag_fp, "\n");
+    }
+    frag_rows++;
+}
+
+/*
+ * frag_close - Finish the timeline of the current trace
+ */
+static void frag_close(void)
+{
+    if (frag_fp == NULL)
+	return;
+    if (frag_json)
+	fprintf(frag_fp, "\n]}\n");
+    fclose(frag_fp);
+    frag_fp = NULL;
 }
 
 /*
@@ -841,7 +2001,7 @@ static void eval_mm_speed(void *ptr)
  */
 static int eval_libc_valid(trace_t *trace, int tracenum)
 {
-    int i, newsize;
+    int i, j, newsize;
     char *p, *newp, *oldp;
 
     for (i = 0;  i < trace->num_ops;  i++) {
@@ -855,6 +2015,23 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 	    trace->blocks[trace->ops[i].index] = p;
 	    break;
 
+	case MEMALIGN: /* posix_memalign */
+	    if (posix_memalign((void **)&p, trace->ops[i].alignment, 
+			       trace->ops[i].size) != 0) {
+		malloc_error(tracenum, i, "libc posix_memalign failed");
+		unix_error("System message");
+	    }
+	    trace->blocks[trace->ops[i].index] = p;
+	    break;
+
+	case CALLOC: /* calloc */
+	    if ((p = calloc(1, trace->ops[i].size)) == NULL) {
+		malloc_error(tracenum, i, "libc calloc failed");
+		unix_error("System message");
+	    }
+	    trace->blocks[trace->ops[i].index] = p;
+	    break;
+
 	case REALLOC: /* realloc */
             newsize = trace->ops[i].size;
 	    oldp = trace->blocks[trace->ops[i].index];
@@ -869,6 +2046,41 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 	    free(trace->blocks[trace->ops[i].index]);
 	    break;
 
+	case ALLOC_BATCH: /* one malloc per block */
+	    for (j = 0; j < trace->ops[i].count; j++) {
+		if ((p = malloc(trace->ops[i].size)) == NULL) {
+		    malloc_error(tracenum, i, "libc malloc failed");
+		    unix_error("System message");
+		}
+		trace->blocks[trace->ops[i].index + j] = p;
+	    }
+	    break;
+
+	case FREE_BATCH: /* one free per block */
+	    for (j = 0; j < trace->ops[i].count; j++)
+		free(trace->blocks[trace->ops[i].index + j]);
+	    break;
+
+	case ARENA_BEGIN: /* libc has no arenas */
+	    break;
+
+	case ARENA_ALLOC: /* malloc */
+	    if ((p = malloc(trace->ops[i].size)) == NULL) {
+		malloc_error(tracenum, i, "libc malloc failed");
+		unix_error("System message");
+	    }
+	    trace->blocks[trace->ops[i].index] = p;
+	    break;
+
+	case ARENA_FREE: /* free */
+	    free(trace->blocks[trace->ops[i].index]);
+	    break;
+
+	case ARENA_END: /* free what is left in the scope */
+	    for (j = 0; j < trace->ops[i].count; j++)
+		free(trace->blocks[trace->ops[i].ids[j]]);
+	    break;
+
 	default:
 	    app_error("invalid operation type  in eval_libc_valid");
 	}
@@ -884,7 +2096,7 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
  */
 static void eval_libc_speed(void *ptr)
 {
-    int i;
+    int i, j;
     int index, size, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
@@ -899,6 +2111,22 @@ static void eval_libc_speed(void *ptr)
 	    trace->blocks[index] = p;
 	    break;
 
+	case MEMALIGN: /* posix_memalign */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    if (posix_memalign((void **)&p, trace->ops[i].alignment, size) != 0)
+		unix_error("posix_memalign failed in eval_libc_speed");
+	    trace->blocks[index] = p;
+	    break;
+
+	case CALLOC: /* calloc */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    if ((p = calloc(1, size)) == NULL)
+		unix_error("calloc failed in eval_libc_speed");
+	    trace->blocks[index] = p;
+	    break;
+
 	case REALLOC: /* realloc */
 	    index = trace->ops[i].index;
 	    newsize = trace->ops[i].size;
@@ -914,6 +2142,42 @@ static void eval_libc_speed(void *ptr)
 	    block = trace->blocks[index];
 	    free(block);
 	    break;
+
+	case ALLOC_BATCH: /* one malloc per block */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    for (j = 0; j < trace->ops[i].count; j++) {
+		if ((p = malloc(size)) == NULL)
+		    unix_error("malloc failed in eval_libc_speed");
+		trace->blocks[index + j] = p;
+	    }
+	    break;
+
+	case FREE_BATCH: /* one free per block */
+	    index = trace->ops[i].index;
+	    for (j = 0; j < trace->ops[i].count; j++)
+		free(trace->blocks[index + j]);
+	    break;
+
+	case ARENA_BEGIN: /* libc has no arenas */
+	    break;
+
+	case ARENA_ALLOC: /* malloc */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    if ((p = malloc(size)) == NULL)
+		unix_error("malloc failed in eval_libc_speed");
+	    trace->blocks[index] = p;
+	    break;
+
+	case ARENA_FREE: /* free */
+	    free(trace->blocks[trace->ops[i].index]);
+	    break;
+
+	case ARENA_END: /* free what is left in the scope */
+	    for (j = 0; j < trace->ops[i].count; j++)
+		free(trace->blocks[trace->ops[i].ids[j]]);
+	    break;
 	}
     }
 }
@@ -980,6 +2244,108 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * printcounters - prints the op counters of a -DMM_STATS build of mm.c
+ *     for each trace, if it kept them
+ */
+static void printcounters(int n, stats_t *stats)
+{
+    int i;
+    mm_stats_t *c;
+
+    for (i = 0; i < n && !stats[i].counted; i++)
+	;
+    if (i == n)
+	return;
+
+    printf("\n%5s %7s %7s %6s %23s %6s %8s %15s %8s %13s\n", "trace", "fits", 
+	   "visits", "splits", "coalesce none/r/l/both", "sbrks", "sbrk KB", 
+	   "realloc in/copy", "copy KB", "quick hit/fl");
+    for (i = 0; i < n; i++) {
+	if (!stats[i].counted)
+	    continue;
+	c = &stats[i].counters;
+	printf("%2d    %7lu %7.1f %6lu %5lu %5lu %5lu %5lu %6lu %8lu %7lu %7lu %8lu %7lu %5lu\n",
+	       i, c->fits, c->fits ? (double)c->fit_visits / c->fits : 0, 
+	       c->splits, c->coalesce[0], c->coalesce[1], c->coalesce[2], 
+	       c->coalesce[3], c->extends, c->extend_bytes / 1024, 
+	       c->realloc_inplace, c->realloc_copy, c->realloc_copied / 1024,
+	       c->quick_hits, c->quick_flushes);
+    }
+    printf("(visits is per fit)\n");
+}
+
+/*
+ * printreport - Write the results of every variant, and of libc if it
+ *     was run, as JSON or CSV for tools that track performance over time
+ */
+static void printreport(char **tracefiles, int n, variant_t *variants, 
+			int num_variants, stats_t *libc_stats)
+{
+    int i, j;
+    stats_t *stats;
+    double kops, libc_kops;
+
+    if (out_format == OUT_JSON) {
+	fprintf(out_fp, "{\"build\": {\"compiler\": \"%s\", \"cflags\": \"%s\", "
+		"\"timer\": \"%s\", \"alignment\": %d},\n"
+		" \"index\": {\"util_weight\": %.3f, \"cap_kops\": %.1f},\n"
+		" \"variants\": [", __VERSION__, BUILD_CFLAGS, TIMER_NAME, 
+		ALIGNMENT, util_weight, thru_cap/1e3);
+    } else {
+	fprintf(out_fp, "allocator,trace,valid,ops,secs,kops,util,heap,"
+		"libc_kops,libc_ratio,perfindex,total_kops,cap_kops,util_weight,"
+		"compiler,cflags,timer\n");
+    }
+
+    for (j = 0; j < num_variants; j++) {
+	stats = variants[j].stats;
+	if (out_format == OUT_JSON)
+	    fprintf(out_fp, "%s\n  {\"allocator\": \"%s\", \"perfindex\": %.2f, "
+		    "\"total_kops\": %.1f, \"errors\": %d, \"traces\": [", 
+		    j ? "," : "", variants[j].allocator->name, 
+		    variants[j].perfindex, variants[j].thruput/1e3, 
+		    variants[j].errors);
+
+	for (i = 0; i < n; i++) {
+	    kops = stats[i].valid ? (stats[i].ops/1e3)/stats[i].secs : 0;
+	    libc_kops = (libc_stats && libc_stats[i].valid) ? 
+		(libc_stats[i].ops/1e3)/libc_stats[i].secs : 0;
+
+	    if (out_format == OUT_JSON) {
+		fprintf(out_fp, "%s\n    {\"trace\": \"%s\", \"valid\": %s, "
+			"\"ops\": %.0f, \"secs\": %.6f, \"kops\": %.1f, "
+			"\"util\": %.4f, \"heap\": %.0f, ", 
+			i ? "," : "", tracefiles[i], 
+			stats[i].valid ? "true" : "false", stats[i].ops, 
+			stats[i].secs, kops, stats[i].util, stats[i].heap);
+		if (libc_kops > 0)
+		    fprintf(out_fp, "\"libc_kops\": %.1f, \"libc_ratio\": %.3f}",
+			    libc_kops, kops / libc_kops);
+		else
+		    fprintf(out_fp, "\"libc_kops\": null, \"libc_ratio\": null}");
+	    } else {
+		fprintf(out_fp, "%s,%s,%d,%.0f,%.6f,%.1f,%.4f,%.0f,", 
+			variants[j].allocator->name, tracefiles[i], 
+			stats[i].valid, stats[i].ops, stats[i].secs, kops, 
+			stats[i].util, stats[i].heap);
+		if (libc_kops > 0)
+		    fprintf(out_fp, "%.1f,%.3f,", libc_kops, kops / libc_kops);
+		else
+		    fprintf(out_fp, ",,");
+		fprintf(out_fp, "%.2f,%.1f,%.1f,%.3f,\"%s\",\"%s\",%s\n", 
+			variants[j].perfindex, variants[j].thruput/1e3, 
+			thru_cap/1e3, util_weight, __VERSION__, BUILD_CFLAGS, 
+			TIMER_NAME);
+	    }
+	}
+	if (out_format == OUT_JSON)
+	    fprintf(out_fp, "\n  ]}");
+    }
+    if (out_format == OUT_JSON)
+	fprintf(out_fp, "\n]}\n");
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -1007,19 +2373,181 @@ void malloc_error(int tracenum, int opnum, char *msg)
     printf("ERROR [trace %d, line %d]: %s\n", tracenum, LINENUM(opnum), msg);
 }
 
+/*****************************************************************
+ * Baselines: the per-trace results of an earlier run, saved with -B, 
+ * that later runs are compared against with -C
+ ****************************************************************/
+
+/*
+ * time_trace - Time f(params) num_samples times. stats gets the mean 
+ *     of the times and the standard deviation of the throughputs.
+ */
+static void time_trace(fsecs_test_funct f, speed_t *params, stats_t *stats)
+{
+    int k;
+    double secs, kops, sum = 0, kops_sum = 0, kops_sq = 0;
+
+    for (k = 0; k < num_samples; k++) {
+	secs = fsecs(f, params);
+	kops = (stats->ops/1e3)/secs;
+	sum += secs;
+	kops_sum += kops;
+	kops_sq += kops * kops;
+    }
+    stats->samples = num_samples;
+    stats->secs = sum / num_samples;
+    stats->kops_sd = 0;
+    if (num_samples > 1)
+	stats->kops_sd = sqrt(fmax(0, (kops_sq - kops_sum*kops_sum/num_samples) 
+				   / (num_samples - 1)));
+}
+
+/*
+ * save_baseline - Write the results of every valid trace to file, one 
+ *     JSON object per line so compare_baseline can read it back
+ */
+static void save_baseline(char *file, char **tracefiles, int n, 
+			  variant_t *variants, int num_variants)
+{
+    FILE *fp;
+    stats_t *stats;
+    int i, j, first = 1;
+
+    if ((fp = fopen(file, "w")) == NULL)
+	unix_error("Could not open the -B baseline");
+    fprintf(fp, "{\"baseline\": [\n");
+    for (j = 0; j < num_variants; j++) {
+	stats = variants[j].stats;
+	for (i = 0; i < n; i++) {
+	    if (!stats[i].valid)
+		continue;
+	    fprintf(fp, "%s{\"allocator\": \"%s\", \"trace\": \"%s\", "
+		    "\"samples\": %d, \"kops\": %.3f, \"kops_sd\": %.3f, "
+		    "\"util\": %.4f}", first ? "" : ",\n", 
+		    variants[j].allocator->name, tracefiles[i], stats[i].samples,
+		    (stats[i].ops/1e3)/stats[i].secs, stats[i].kops_sd, 
+		    stats[i].util);
+	    first = 0;
+	}
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    printf("Saved baseline %s\n", file);
+}
+
+/*
+ * compare_baseline - Compare the results with the baseline in file and 
+ *     print every trace that regressed. Traces and variants that are not 
+ *     in the baseline are skipped. Returns the number of regressions.
+ */
+static int compare_baseline(char *file, double tolerance, char **tracefiles, 
+			    int n, variant_t *variants, int num_variants)
+{
+    FILE *fp;
+    char line[MAXLINE], name[MAXLINE], tracename[MAXLINE];
+    int i, j, base_samples, compared = 0, regressions = 0;
+    double base_kops, base_sd, base_util, kops, drop, se;
+    stats_t *stats;
+
+    if ((fp = fopen(file, "r")) == NULL)
+	unix_error("Could not open the -C baseline");
+
+    while (fgets(line, MAXLINE, fp) != NULL) {
+	if (sscanf(line, " {\"allocator\": \"%[^\"]\", \"trace\": \"%[^\"]\", "
+		   "\"samples\": %d, \"kops\": %lf, \"kops_sd\": %lf, "
+		   "\"util\": %lf}", name, tracename, &base_samples, &base_kops, 
+		   &base_sd, &base_util) != 6)
+	    continue;
+	for (j = 0; j < num_variants; j++)
+	    if (!strcmp(variants[j].allocator->name, name))
+		break;
+	for (i = 0; i < n; i++)
+	    if (!strcmp(tracefiles[i], tracename))
+		break;
+	if (j == num_variants || i == n)
+	    continue;
+	stats = &variants[j].stats[i];
+	compared++;
+
+	if (!stats->valid) {
+	    printf("REGRESSION %s %s: no longer valid\n", name, tracename);
+	    regressions++;
+	    continue;
+	}
+
+	/* Throughput, against the noise of both runs */
+	kops = (stats->ops/1e3)/stats->secs;
+	drop = base_kops - kops;
+	se = sqrt(base_sd*base_sd/base_samples + 
+		  stats->kops_sd*stats->kops_sd/stats->samples);
+	if (drop > tolerance * base_kops && drop > THRU_SIGMAS * se) {
+	    printf("REGRESSION %s %s: %.0f Kops, baseline %.0f +- %.0f (%+.1f%%)\n",
+		   name, tracename, kops, base_kops, base_sd, 
+		   -100.0 * drop / base_kops);
+	    regressions++;
+	}
+	else if (verbose)
+	    printf("ok %s %s: %.0f Kops, baseline %.0f +- %.0f (%+.1f%%)\n",
+		   name, tracename, kops, base_kops, base_sd, 
+		   -100.0 * drop / base_kops);
+
+	/* Utilization */
+	if (stats->util < base_util - UTIL_TOLERANCE) {
+	    printf("REGRESSION %s %s: util %.1f%%, baseline %.1f%%\n", 
+		   name, tracename, 100*stats->util, 100*base_util);
+	    regressions++;
+	}
+    }
+    fclose(fp);
+
+    printf("Compared %d traces with baseline %s: %d regressions\n", 
+	   compared, file, regressions);
+    return regressions;
+}
+
 /* 
  * usage - Explain the command line arguments
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>] [-A <name>] [-d <level>] [-s <n>] [-o <fmt>]\n"
+	    "               [-B <file>] [-C <file>[,<tol>]] [-c <cap>] [-w <w>] [-j <n>] [-m <mode>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-B <file>  Save the results as a baseline for -C.\n");
+    fprintf(stderr, "\t-C <file>[,<tol>] Compare the results with a baseline and\n");
+    fprintf(stderr, "\t           exit with status 2 if a trace got slower by more\n");
+    fprintf(stderr, "\t           than <tol> (default 0.05) and the timing noise, or\n");
+    fprintf(stderr, "\t           its util dropped.\n");
+    fprintf(stderr, "\t-A <name>  Evaluate allocator variant <name> (default mm),\n");
+    fprintf(stderr, "\t           or \"all\" to compare every linked variant.\n");
+    fprintf(stderr, "\t-c <Kops>  Throughput that gets full marks in the perf index\n");
+    fprintf(stderr, "\t           (default %.0f), or libc[,<x>] for x times the\n", 
+	    AVG_LIBC_THRUPUT/1e3);
+    fprintf(stderr, "\t           throughput of libc malloc on this host.\n");
+    fprintf(stderr, "\t-d <l>[,n] mm.c debug level: 0 off, 1 check, 2 print and check.\n");
+    fprintf(stderr, "\t           At level 1 the whole heap is checked every n ops\n");
+    fprintf(stderr, "\t           (default 1024, 0 for never). Needs mdriver64-debug.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-j <n>[,serial] Evaluate n traces at once in child processes\n");
+    fprintf(stderr, "\t           pinned to their own CPUs (0 for one per CPU). With\n");
+    fprintf(stderr, "\t           serial, only one of them times its trace at a time.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-m <mode>  Payload checks: full (default), off, or\n");
+    fprintf(stderr, "\t           sample[,<n>[,<bytes>]] for all of every n'th\n");
+    fprintf(stderr, "\t           block (16) and the ends (64 bytes) of the rest.\n");
+    fprintf(stderr, "\t-o <fmt>[,<file>] Also write the results as json or csv,\n");
+    fprintf(stderr, "\t           to <file> or to stdout (the usual output then\n");
+    fprintf(stderr, "\t           goes to stderr).\n");
+    fprintf(stderr, "\t-s <n>[,json] Sample the heap every n ops and write a\n");
+    fprintf(stderr, "\t           fragmentation timeline per trace and variant to\n");
+    fprintf(stderr, "\t           <trace>.<variant>.frag.csv (or .json).\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
+    fprintf(stderr, "\t-w <w>     Weight of util in the perf index (default %.2f),\n",
+	    UTIL_WEIGHT);
+    fprintf(stderr, "\t           the rest is throughput.\n");
 }
@@ -0,0 +1,132 @@
+/*
+ * memlib-mmap.c - a memlib.c replacement for running mm.c as the real 
+ *     process allocator (libmm.so). Instead of carving the heap out of a 
+ *     malloc'd array it reserves a large range of address space with 
+ *     mmap and makes it accessible page by page as the heap grows, so 
+ *     it never calls back into malloc.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <errno.h>
+
+#include "memlib.h"
+
+/* Size of the reserved address range (only touched pages use memory) */
+#define MMAP_HEAP ((size_t)1 << 36)  /* 64 GB */
+
+/* private variables */
+static char *mem_start_brk;  /* points to first byte of heap */
+static char *mem_brk;        /* points to last byte of heap */
+static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_mapped_brk; /* end of the accessible part of the range */
+static char *mem_zero_brk;   /* storage from here up has never been in the heap */
+
+/* 
+ * mem_init - reserve the address range for the heap
+ */
+void mem_init(void)
+{
+    mem_start_brk = mmap(NULL, MMAP_HEAP, PROT_NONE, 
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_start_brk == MAP_FAILED) {
+        mem_start_brk = NULL;
+        return;
+    }
+
+    mem_max_addr = mem_start_brk + MMAP_HEAP;  /* max legal heap address */
+    mem_brk = mem_start_brk;                   /* heap is empty initially */
+    mem_mapped_brk = mem_start_brk;
+    mem_zero_brk = mem_start_brk;
+}
+
+/* 
+ * mem_deinit - give the address range back to the system
+ */
+void mem_deinit(void)
+{
+    if (mem_start_brk != NULL)
+        munmap(mem_start_brk, MMAP_HEAP);
+    mem_start_brk = NULL;
+}
+
+/*
+ * mem_reset_brk - reset the brk pointer to make an empty heap
+ */
+void mem_reset_brk()
+{
+    if (mem_brk > mem_zero_brk)
+        mem_zero_brk = mem_brk;
+    mem_brk = mem_start_brk;
+}
+
+/* 
+ * mem_sbrk - Extends the heap by incr bytes and returns the start 
+ *    address of the new area, making new pages accessible as needed. 
+ *    The heap cannot be shrunk.
+ */
+void *mem_sbrk(int incr) 
+{
+    char *old_brk = mem_brk;
+    size_t grow;
+
+    if (mem_start_brk == NULL || (incr < 0) || 
+        ((mem_brk + incr) > mem_max_addr)) {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+    if (mem_brk + incr > mem_mapped_brk) {
+        grow = mem_brk + incr - mem_mapped_brk;
+        grow = (grow + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+        if (mprotect(mem_mapped_brk, grow, PROT_READ | PROT_WRITE) < 0) {
+            errno = ENOMEM;
+            return (void *)-1;
+        }
+        mem_mapped_brk += grow;
+    }
+    mem_brk += incr;
+    return (void *)old_brk;
+}
+
+/*
+ * mem_heap_lo - return address of the first heap byte
+ */
+void *mem_heap_lo()
+{
+    return (void *)mem_start_brk;
+}
+
+/* 
+ * mem_heap_hi - return address of last heap byte
+ */
+void *mem_heap_hi()
+{
+    return (void *)(mem_brk - 1);
+}
+
+/*
+ * mem_zero_lo - return the lowest address from which on the storage was
+ *    still zero (fresh anonymous pages) when the heap was last reset
+ */
+void *mem_zero_lo()
+{
+    return (void *)mem_zero_brk;
+}
+
+/*
+ * mem_heapsize() - returns the heap size in bytes
+ */
+size_t mem_heapsize() 
+{
+    return (size_t)(mem_brk - mem_start_brk);
+}
+
+/*
+ * mem_pagesize() - returns the page size of the system
+ */
+size_t mem_pagesize()
+{
+    return (size_t)getpagesize();
+}
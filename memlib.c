@@ -18,20 +18,23 @@
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_zero_brk;   /* storage from here up has never been in the heap */
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
+    /* allocate the storage we will use to model the available VM, 
+       zeroed like the pages a real sbrk hands out */
+    if ((mem_start_brk = (char *)calloc(1, MAX_HEAP)) == NULL) {
         fprintf(stderr, "mem_init_vm: malloc error\n");
         exit(1);
     }
 
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_zero_brk = mem_start_brk;
 }
 
 /* 
@@ -47,6 +50,8 @@ void mem_deinit(void)
  */
 void mem_reset_brk()
 {
+    if (mem_brk > mem_zero_brk)
+        mem_zero_brk = mem_brk;
     mem_brk = mem_start_brk;
 }
 
@@ -84,6 +89,16 @@ void *mem_heap_hi()
     return (void *)(mem_brk - 1);
 }
 
+/*
+ * mem_zero_lo - return the lowest address from which on the storage was
+ *    still zero when the heap was last reset. Memory above it is zero
+ *    unless the current heap owner has written it.
+ */
+void *mem_zero_lo()
+{
+    return (void *)mem_zero_brk;
+}
+
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
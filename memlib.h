@@ -6,6 +6,7 @@ void *mem_sbrk(int incr);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_zero_lo(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
 
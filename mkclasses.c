@@ -0,0 +1,186 @@
+/*
+ * mkclasses.c - Generates mm-classes.h, the size classes mm.c rounds
+ * small requests up to, from the request sizes in a set of traces:
+ *
+ *     unix> make classes CLASS_TRACES="a.rep b.rep"
+ *
+ * Requests of up to max bytes (512 by default) are counted by their size
+ * rounded up to 8 bytes. A class covers a run of those sizes and is as
+ * big as the largest one, so every request in it wastes the difference.
+ * The classes are chosen to waste the fewest bytes over all the requests
+ * in the traces, with at most n classes (16 by default). The last class
+ * always ends at max.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAXLINE 1024
+#define MAX_SIZE 4096   /* biggest -m accepted */
+
+static double hist[MAX_SIZE/8 + 1];  /* requests of each size / 8 */
+
+static void read_trace(char *path);
+static void count(unsigned size, unsigned n);
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: mkclasses [-n <classes>] [-m <max>] <trace.rep>...\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int classes = 16;       /* class budget */
+    int max = 512;          /* biggest request covered by the table */
+    int units, i, j, k, c;
+    double *sum, *wsum;     /* prefix sums of hist and of u * hist[u] */
+    double *waste, *prev;   /* best waste for units 1..j with k classes */
+    int *from;              /* where the last class of that best starts */
+    int *bound;             /* largest size / 8 in each class */
+    double total = 0, wasted;
+
+    while ((c = getopt(argc, argv, "n:m:")) != EOF) {
+        switch (c) {
+        case 'n':
+            classes = atoi(optarg);
+            break;
+        case 'm':
+            max = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind == argc || classes < 1 || classes > 255 ||
+        max < 8 || max > MAX_SIZE || max % 8)
+        usage();
+    for (i = optind; i < argc; i++)
+        read_trace(argv[i]);
+
+    units = max / 8;
+    if (classes > units)
+        classes = units;
+    sum = calloc(units + 1, sizeof(double));
+    wsum = calloc(units + 1, sizeof(double));
+    waste = malloc((units + 1) * sizeof(double));
+    prev = malloc((units + 1) * sizeof(double));
+    from = malloc((classes + 1) * (units + 1) * sizeof(int));
+    bound = malloc(classes * sizeof(int));
+    if (!sum || !wsum || !waste || !prev || !from || !bound) {
+        fprintf(stderr, "mkclasses: out of memory\n");
+        exit(1);
+    }
+    for (i = 1; i <= units; i++) {
+        sum[i] = sum[i-1] + hist[i];
+        wsum[i] = wsum[i-1] + i * hist[i];
+        total += hist[i];
+    }
+
+    /*
+     * A class covering units i..j wastes 8 * sum (j - u) * hist[u].
+     * waste[j] is the least waste of units 1..j in k classes, built up
+     * one class at a time from prev, the least in k-1.
+     */
+    for (j = 0; j <= units; j++)
+        waste[j] = j ? 8 * (j * sum[j] - wsum[j]) : 0;
+    for (j = 0; j <= units; j++)
+        from[units + 1 + j] = 1;
+    for (k = 2; k <= classes; k++) {
+        memcpy(prev, waste, (units + 1) * sizeof(double));
+        for (j = k; j <= units; j++) {
+            waste[j] = -1;
+            for (i = k; i <= j; i++) {
+                double w = prev[i-1] +
+                    8 * (j * (sum[j] - sum[i-1]) - (wsum[j] - wsum[i-1]));
+                if (waste[j] < 0 || w < waste[j]) {
+                    waste[j] = w;
+                    from[k * (units + 1) + j] = i;
+                }
+            }
+        }
+    }
+
+    /* Walk the choices back from units */
+    for (k = classes, j = units; k > 0; k--) {
+        bound[k-1] = j;
+        j = from[k * (units + 1) + j] - 1;
+    }
+    wasted = waste[units];
+
+    printf("/*\n * mm-classes.h - Size classes for small requests, generated by\n");
+    printf(" * \"mkclasses -n %d -m %d\" from:\n *\n", classes, max);
+    for (i = optind; i < argc; i++) {
+        char *name = strrchr(argv[i], '/');
+        printf(" *     %s\n", name ? name + 1 : argv[i]);
+    }
+    printf(" *\n * %.0f requests of up to %d bytes, %.2f bytes wasted per request.\n",
+           total, max, total ? wasted / total : 0);
+    printf(" * Do not edit - rerun \"make classes\" instead.\n */\n");
+    printf("#define MM_CLASS_MAX %d  /* largest request with a class */\n", max);
+    printf("#define MM_CLASSES   %d\n\n", classes);
+
+    printf("/* Request size of each class */\n");
+    printf("static const unsigned short mm_class_size[MM_CLASSES] = {");
+    for (k = 0; k < classes; k++)
+        printf("%s%s%d", k ? "," : "", k % 8 ? " " : "\n    ", 8 * bound[k]);
+    printf("\n};\n\n");
+
+    printf("/* Class of a request, by (size+7)>>3 */\n");
+    printf("static const unsigned char mm_class_index[MM_CLASS_MAX/8 + 1] = {");
+    for (i = 0, k = 0; i <= units; i++) {
+        while (i > bound[k])
+            k++;
+        printf("%s%s%d", i ? "," : "", i % 16 ? " " : "\n    ", k);
+    }
+    printf("\n};\n");
+    return 0;
+}
+
+/*
+ * read_trace - Count the request sizes of one trace. Only the lines
+ * that carry a size matter, the rest are skipped.
+ */
+static void read_trace(char *path)
+{
+    FILE *fp;
+    char line[MAXLINE];
+    unsigned id, size, alignment, n;
+    int header = 4;     /* heap size, ids, ops and weight come first */
+
+    if ((fp = fopen(path, "r")) == NULL) {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(line, MAXLINE, fp) != NULL) {
+        if (header > 0) {
+            header--;
+            continue;
+        }
+        switch (line[0]) {
+        case 'a':
+        case 'r':
+        case 'c':
+            if (sscanf(line + 1, "%u %u", &id, &size) == 2)
+                count(size, 1);
+            break;
+        case 'm':
+            if (sscanf(line + 1, "%u %u %u", &id, &alignment, &size) == 3)
+                count(size, 1);
+            break;
+        case 'A':
+            if (sscanf(line + 1, "%u %u %u", &id, &n, &size) == 3)
+                count(size, n);
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+/* count - Count n requests of size bytes, if any table could cover them */
+static void count(unsigned size, unsigned n)
+{
+    if (size > 0 && size <= MAX_SIZE)
+        hist[(size + 7) >> 3] += n;
+}
@@ -0,0 +1,125 @@
+/*
+ * mm-arena.c - Region allocation on top of mm.c.
+ *
+ * An arena takes big chunks from mm_malloc and hands out objects by
+ * bumping a pointer through the current chunk. The objects carry no
+ * header and cannot be freed one at a time. mm_arena_reset gives every
+ * chunk back with one mm_free each, so dropping everything allocated in
+ * the arena costs no per-object free or coalesce work.
+ *
+ * Requests bigger than a quarter of a chunk get a chunk of their own, so
+ * they do not throw away the rest of the current one.
+ */
+#include <stdio.h>
+
+#include "mm.h"
+
+#define ARENA_CHUNK (1<<12)             /* usable bytes in a chunk */
+#define ARENA_ALIGN (2*sizeof(size_t))  /* object alignment, as mm.c's */
+
+/* rounds up to the nearest multiple of ARENA_ALIGN */
+#define ALIGN(size) (((size) + (ARENA_ALIGN-1)) & ~(ARENA_ALIGN-1))
+
+/* Every chunk starts with a link to the chunk allocated before it */
+typedef struct chunk {
+    struct chunk *next;
+} chunk_t;
+
+#define CHUNK_HDR ALIGN(sizeof(chunk_t))
+
+struct mm_arena {
+    chunk_t *chunks;  /* all chunks of the arena, newest first */
+    char *cur;        /* next free byte in the current chunk */
+    char *end;        /* end of the current chunk */
+};
+
+static chunk_t *new_chunk(mm_arena_t *arena, size_t size);
+
+/*
+ * mm_arena_create - Create an empty arena. The arena record itself is
+ * allocated with mm_malloc. Returns NULL if that fails.
+ */
+mm_arena_t *mm_arena_create(void)
+{
+    mm_arena_t *arena;
+
+    if ((arena = mm_malloc(sizeof(mm_arena_t))) == NULL)
+        return NULL;
+    arena->chunks = NULL;
+    arena->cur = arena->end = NULL;
+    return arena;
+}
+
+/*
+ * mm_arena_alloc - Allocate size bytes from arena. The object lives until
+ * the arena is reset or destroyed.
+ */
+void *mm_arena_alloc(mm_arena_t *arena, size_t size)
+{
+    chunk_t *chunk;
+    char *p;
+
+    /* Ignore spurious requests, and ones too big to align or give a chunk */
+    if (size == 0 || size > (size_t)-1 / 2)
+        return NULL;
+
+    size = ALIGN(size);
+    if (size > (size_t)(arena->end - arena->cur)) {
+        /* Big objects get a chunk of their own */
+        if (size > ARENA_CHUNK / 4) {
+            if ((chunk = new_chunk(arena, size)) == NULL)
+                return NULL;
+            return (char *)chunk + CHUNK_HDR;
+        }
+
+        /* Start a new chunk and leave the rest of the old one unused */
+        if ((chunk = new_chunk(arena, ARENA_CHUNK)) == NULL)
+            return NULL;
+        arena->cur = (char *)chunk + CHUNK_HDR;
+        arena->end = arena->cur + ARENA_CHUNK;
+    }
+
+    p = arena->cur;
+    arena->cur += size;
+    return p;
+}
+
+/*
+ * mm_arena_reset - Free every object in arena at once, by giving its
+ * chunks back to mm_free. The arena can be used again afterwards.
+ */
+void mm_arena_reset(mm_arena_t *arena)
+{
+    chunk_t *chunk, *next;
+
+    for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        mm_free(chunk);
+    }
+    arena->chunks = NULL;
+    arena->cur = arena->end = NULL;
+}
+
+/*
+ * mm_arena_destroy - Free every object in arena and the arena itself
+ */
+void mm_arena_destroy(mm_arena_t *arena)
+{
+    mm_arena_reset(arena);
+    mm_free(arena);
+}
+
+/*
+ * new_chunk - Get a chunk with size usable bytes from mm_malloc and link
+ * it into arena
+ */
+static chunk_t *new_chunk(mm_arena_t *arena, size_t size)
+{
+    chunk_t *chunk;
+
+    if ((chunk = mm_malloc(CHUNK_HDR + size)) == NULL)
+        return NULL;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    return chunk;
+}
@@ -0,0 +1,34 @@
+/*
+ * mm-classes.h - Size classes for small requests, generated by
+ * "mkclasses -n 64 -m 512" from:
+ *
+ *     churn-bal.rep
+ *     short1-bal.rep
+ *     short2-bal.rep
+ *
+ * 2253 requests of up to 512 bytes, 0.00 bytes wasted per request.
+ * Do not edit - rerun "make classes" instead.
+ */
+#define MM_CLASS_MAX 512  /* largest request with a class */
+#define MM_CLASSES   64
+
+/* Request size of each class */
+static const unsigned short mm_class_size[MM_CLASSES] = {
+    8, 16, 24, 32, 40, 48, 56, 64,
+    72, 80, 88, 96, 104, 112, 120, 128,
+    136, 144, 152, 160, 168, 176, 184, 192,
+    200, 208, 216, 224, 232, 240, 248, 256,
+    264, 272, 280, 288, 296, 304, 312, 320,
+    328, 336, 344, 352, 360, 368, 376, 384,
+    392, 400, 408, 416, 424, 432, 440, 448,
+    456, 464, 472, 480, 488, 496, 504, 512
+};
+
+/* Class of a request, by (size+7)>>3 */
+static const unsigned char mm_class_index[MM_CLASS_MAX/8 + 1] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30,
+    31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46,
+    47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62,
+    63
+};
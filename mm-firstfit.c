@@ -44,10 +44,15 @@ team_t team = {
 
 /* $begin mallocmacros */
 /* Basic constants and macros */
+#if defined(__LP64__) && !defined(MM_COMPACT)
+#define WSIZE       8       /* word size (bytes) */  
+#define DSIZE       16      /* doubleword size (bytes) */
+#else
 #define WSIZE       4       /* word size (bytes) */  
 #define DSIZE       8       /* doubleword size (bytes) */
+#endif
 #define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
-#define OVERHEAD    8       /* overhead of header and footer (bytes) */
+#define OVERHEAD    DSIZE   /* overhead of header and footer (bytes) */
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))  
 
@@ -55,8 +60,13 @@ team_t team = {
 #define PACK(size, alloc)  ((size) | (alloc))
 
 /* Read and write a word at address p */
+#if WSIZE == 4
+#define GET(p)       (*(unsigned int *)(p))
+#define PUT(p, val)  (*(unsigned int *)(p) = (val))  
+#else
 #define GET(p)       (*(size_t *)(p))
 #define PUT(p, val)  (*(size_t *)(p) = (val))  
+#endif
 
 /* (which is about 54/100).* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
@@ -319,14 +329,14 @@ static void printblock(void *bp)
         return;
     }
 
-    printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp, 
+    printf("%p: header: [%zu:%c] footer: [%zu:%c]\n", bp, 
            hsize, (halloc ? 'a' : 'f'), 
            fsize, (falloc ? 'a' : 'f')); 
 }
 
 static void checkblock(void *bp) 
 {
-    if ((size_t)bp % 8)
+    if ((size_t)bp % DSIZE)
         printf("Error: %p is not doubleword aligned\n", bp);
     if (GET(HDRP(bp)) != GET(FTRP(bp)))
         printf("Error: header does not match footer\n");
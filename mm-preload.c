@@ -0,0 +1,206 @@
+/*
+ * mm-preload.c - Exports the standard malloc family on top of mm.c so 
+ *     that unmodified programs can run on our allocator:
+ *
+ *         unix> LD_PRELOAD=./libmm.so ls -l
+ *
+ * The heap comes from memlib-mmap.c. mm.c is not thread safe, so every 
+ * call goes through one global lock, which is also held across fork() 
+ * so the child never inherits a heap in the middle of an update.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <malloc.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+/* Largest request we pass on - mem_sbrk takes an int */
+#define MAX_REQUEST ((size_t)INT_MAX - (1<<16))
+
+#define MAX(x, y) ((x) > (y)? (x) : (y))
+
+/* Alignment every block gets from mm.c (16 on 64-bit builds) */
+#define MM_ALIGNMENT (2*sizeof(size_t))
+
+static pthread_mutex_t mm_lock = PTHREAD_MUTEX_INITIALIZER;
+static int mm_ready = 0;       /* set once the heap has been created */
+static int mm_failed = 0;      /* set if creating the heap failed */
+static int atfork_done = 0;    /* set once the fork handlers are registered */
+
+static void fork_prepare(void) { pthread_mutex_lock(&mm_lock); }
+static void fork_parent(void)  { pthread_mutex_unlock(&mm_lock); }
+static void fork_child(void)   { pthread_mutex_init(&mm_lock, NULL); }
+
+/*
+ * lock_heap - Take the heap lock, creating the heap on first use. 
+ *     Returns 0 (with the lock released) if there is no heap.
+ */
+static int lock_heap(void)
+{
+    int first = 0;
+
+    pthread_mutex_lock(&mm_lock);
+    if (!mm_ready && !mm_failed) {
+        mem_init();
+        if (mem_heap_lo() == NULL || mm_init() < 0)
+            mm_failed = 1;
+        else
+            mm_ready = first = 1;
+    }
+    if (mm_failed) {
+        pthread_mutex_unlock(&mm_lock);
+        return 0;
+    }
+
+    /* pthread_atfork may call malloc itself, so register the handlers 
+     * with the lock dropped once the heap exists */
+    if (first && !atfork_done) {
+        atfork_done = 1;
+        pthread_mutex_unlock(&mm_lock);
+        pthread_atfork(fork_prepare, fork_parent, fork_child);
+        pthread_mutex_lock(&mm_lock);
+    }
+    return 1;
+}
+
+/* in_heap - Returns true if ptr was handed out by us */
+static int in_heap(void *ptr)
+{
+    return mm_ready && (char *)ptr >= (char *)mem_heap_lo() &&
+        (char *)ptr <= (char *)mem_heap_hi();
+}
+
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (size > MAX_REQUEST) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!lock_heap()) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    p = mm_malloc(size ? size : 1);
+    pthread_mutex_unlock(&mm_lock);
+    if (p == NULL)
+        errno = ENOMEM;
+    return p;
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL || !in_heap(ptr))
+        return;
+    pthread_mutex_lock(&mm_lock);
+    mm_free(ptr);
+    pthread_mutex_unlock(&mm_lock);
+}
+
+/* C23 sized free - size must be what the block was allocated with */
+void free_sized(void *ptr, size_t size)
+{
+    if (ptr == NULL || !in_heap(ptr))
+        return;
+    pthread_mutex_lock(&mm_lock);
+    mm_free_sized(ptr, size);
+    pthread_mutex_unlock(&mm_lock);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    if (ptr == NULL)
+        return malloc(size);
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    if (size > MAX_REQUEST || !in_heap(ptr)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_lock(&mm_lock);
+    p = mm_realloc(ptr, size);
+    pthread_mutex_unlock(&mm_lock);
+    if (p == NULL)
+        errno = ENOMEM;
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (size != 0 && nmemb > MAX_REQUEST / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!lock_heap()) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    p = (nmemb && size) ? mm_calloc(nmemb, size) : mm_malloc(1);
+    pthread_mutex_unlock(&mm_lock);
+    if (p == NULL)
+        errno = ENOMEM;
+    return p;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *p;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) || 
+        alignment % sizeof(void *))
+        return EINVAL;
+    if (alignment <= MM_ALIGNMENT) {
+        if ((p = malloc(size)) == NULL)
+            return ENOMEM;
+        *memptr = p;
+        return 0;
+    }
+    if (size > MAX_REQUEST || alignment > MAX_REQUEST || !lock_heap())
+        return ENOMEM;
+    p = mm_memalign(alignment, size ? size : 1);
+    pthread_mutex_unlock(&mm_lock);
+    if (p == NULL)
+        return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    void *p;
+    int err;
+
+    if ((err = posix_memalign(&p, MAX(alignment, sizeof(void *)), size))) {
+        errno = err;
+        return NULL;
+    }
+    return p;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    return aligned_alloc(alignment, size);
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    size_t size;
+
+    if (ptr == NULL || !in_heap(ptr))
+        return 0;
+    pthread_mutex_lock(&mm_lock);
+    size = mm_usable_size(ptr);
+    pthread_mutex_unlock(&mm_lock);
+    return size;
+}
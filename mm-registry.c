@@ -0,0 +1,124 @@
+/*
+ * mm-registry.c - The table of allocator variants linked into the driver.
+ *
+ * mm.c provides the mm_* functions directly, and mm-arena.c the 
+ * mm_arena_* functions built on them. Every other variant is 
+ * compiled with its entry points renamed to <variant>_* by the Makefile,
+ * and is declared here by hand. To add a variant, add its object and
+ * rename flags to the Makefile and an entry to mm_allocators[].
+ *
+ * mm-backup.c is an unfinished draft (its mm_init never builds a heap)
+ * and is not registered.
+ */
+#include <string.h>
+
+#include "mm.h"
+
+/* mm-firstfit.c, compiled with FIRSTFIT_RENAME */
+extern int firstfit_init(void);
+extern void *firstfit_malloc(size_t size);
+extern void firstfit_free(void *ptr);
+extern void *firstfit_realloc(void *ptr, size_t size);
+extern team_t firstfit_team;
+
+/* mm.c with its placement options off, or one of them on */
+#define LINE_PAD 48
+
+static int mm_policy_init(size_t line_pad, int fit, int quick)
+{
+    mm_set_line_pad(line_pad);
+    mm_set_fit(fit);
+    mm_set_quick(quick);
+    return mm_init();
+}
+
+static int mm_plain_init(void)
+{
+    return mm_policy_init(0, MM_FIT_FIRST, 0);
+}
+
+static int mm_line_init(void)
+{
+    return mm_policy_init(LINE_PAD, MM_FIT_FIRST, 0);
+}
+
+static int mm_next_init(void)
+{
+    return mm_policy_init(0, MM_FIT_NEXT, 0);
+}
+
+static int mm_next_wrap_init(void)
+{
+    return mm_policy_init(0, MM_FIT_NEXT_WRAP, 0);
+}
+
+static int mm_quick_init(void)
+{
+    return mm_policy_init(0, MM_FIT_FIRST, MM_QUICK_LIMIT);
+}
+
+static mm_allocator_t mm_allocator = {
+    "mm", mm_plain_init, mm_malloc, mm_free, mm_realloc, mm_memalign, mm_calloc, 
+    mm_malloc_batch, mm_free_batch, mm_free_sized, 
+    mm_arena_create, mm_arena_alloc, mm_arena_reset, mm_arena_destroy, 
+    mm_heap_walk, mm_stats, &team
+};
+
+static mm_allocator_t mm_line_allocator = {
+    "mm-line", mm_line_init, mm_malloc, mm_free, mm_realloc, mm_memalign, 
+    mm_calloc, mm_malloc_batch, mm_free_batch, mm_free_sized, 
+    mm_arena_create, mm_arena_alloc, mm_arena_reset, mm_arena_destroy, 
+    mm_heap_walk, mm_stats, &team
+};
+
+static mm_allocator_t mm_next_allocator = {
+    "mm-next", mm_next_init, mm_malloc, mm_free, mm_realloc, mm_memalign, 
+    mm_calloc, mm_malloc_batch, mm_free_batch, mm_free_sized, 
+    mm_arena_create, mm_arena_alloc, mm_arena_reset, mm_arena_destroy, 
+    mm_heap_walk, mm_stats, &team
+};
+
+static mm_allocator_t mm_next_wrap_allocator = {
+    "mm-next-wrap", mm_next_wrap_init, mm_malloc, mm_free, mm_realloc, 
+    mm_memalign, mm_calloc, mm_malloc_batch, mm_free_batch, mm_free_sized, 
+    mm_arena_create, mm_arena_alloc, mm_arena_reset, mm_arena_destroy, 
+    mm_heap_walk, mm_stats, &team
+};
+
+static mm_allocator_t mm_quick_allocator = {
+    "mm-quick", mm_quick_init, mm_malloc, mm_free, mm_realloc, mm_memalign, 
+    mm_calloc, mm_malloc_batch, mm_free_batch, mm_free_sized, 
+    mm_arena_create, mm_arena_alloc, mm_arena_reset, mm_arena_destroy, 
+    mm_heap_walk, mm_stats, &team
+};
+
+static mm_allocator_t firstfit_allocator = {
+    "firstfit", firstfit_init, firstfit_malloc, firstfit_free, 
+    firstfit_realloc, NULL, NULL, NULL, NULL, NULL, 
+    NULL, NULL, NULL, NULL, NULL, NULL, &firstfit_team
+};
+
+mm_allocator_t *mm_allocators[] = {
+    &mm_allocator,
+    &mm_line_allocator,
+    &mm_next_allocator,
+    &mm_next_wrap_allocator,
+    &mm_quick_allocator,
+    &firstfit_allocator,
+    NULL
+};
+
+/*
+ * mm_find_allocator - Return the registered variant called name, or
+ *     NULL if there is none
+ */
+mm_allocator_t *mm_find_allocator(char *name)
+{
+    int i;
+
+    for (i = 0; mm_allocators[i] != NULL; i++) {
+        if (!strcmp(mm_allocators[i]->name, name))
+            return mm_allocators[i];
+    }
+    return NULL;
+}
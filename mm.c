@@ -14,6 +14,23 @@
  * information at the end of the block. This information can be used to 
  * navigate the list backwards and is used in the Coalesce function.
  *
+ * Free blocks are also kept on a doubly linked free list. The next and
+ * previous links are stored in the first two words of the free payload,
+ * so a block must be at least MINSIZE bytes to be able to hold them.
+ * Blocks are never bigger than their request needs: when a split would
+ * leave less than MINSIZE, the rest becomes a free "sliver" of OVERHEAD
+ * bytes that is left off the free list until it is coalesced. That way
+ * the block size follows from the payload size, which mm_free_sized
+ * relies on.
+ *
+ * Word size follows the build: 32-bit builds (-m32) use 4 byte tags and
+ * 8 byte alignment, 64-bit builds (make mdriver64) use 8 byte tags, 
+ * 8 byte free list pointers and 16 byte payload alignment.
+ * The compact 64-bit build (make mdriver64-compact, -DMM_COMPACT) keeps
+ * 4 byte tags and stores the free list links as 32-bit offsets from the
+ * start of the heap, so the minimum block stays 16 bytes. This limits 
+ * the heap to 4GB.
+ *
  * The Coalesce function is used to merge two free blocks aligned side by 
  * side to keep track of the real free space instead of spliced sizes.
  * example:   [ 4 |  |  |  | 4 |  |  |  | 4 |  |  |  | 2 |  | 2 |  ]
@@ -25,6 +42,39 @@
  * The program uses the First fit method to allocate the memory to the first 
  * block it can fit in.
  *
+ * Requests of up to MM_CLASS_MAX bytes are rounded up to their size
+ * class, from the table mkclasses made out of the request sizes in the
+ * traces (mm-classes.h). Coarser classes cost a few bytes per block, but
+ * a freed small block fits any later request of its class. The table
+ * "make classes" writes by default has a class per 8 bytes, which rounds
+ * no further than the alignment does.
+ *
+ * Coalescing can be deferred for small blocks: mm_free puts a block of
+ * up to QUICK_MAX bytes on the quick list of its size, still marked allocated
+ * in its tags (plus the QUICK bit), and mm_malloc hands it straight back
+ * to the next request of that size. The blocks of a quick list are 
+ * freed for real when it reaches quick_limit blocks (mm_set_quick, or
+ * MM_QUICK). When a fit search fails, the quick blocks big enough for
+ * the request are freed one at a time until one of them makes a fit.
+ * The lists are off unless quick_limit is set: they save coalescing
+ * work but leave holes the fit searches cannot use.
+ *
+ * With mm_set_fit (or MM_FIT) the search can instead be next fit: it 
+ * starts at a roving pointer into the free list, which is left at the 
+ * remainder of the last block split (it takes the split block's place on
+ * the list), or else at the free block after the last one taken, and
+ * optionally wraps around to the head of the list.
+ *
+ * Built with -DMM_STATS (make mdriver64-stats) mm.c counts what its
+ * operations cost - free blocks visited by the fit searches, splits, 
+ * coalesce cases, heap extensions and reallocs in place or copied - and
+ * hands the counts out through mm_stats.
+ *
+ * Optionally (mm_set_line_pad, or MM_LINE_PAD in the environment) small
+ * payloads are kept from straddling two cache lines: mm_malloc then 
+ * prefers a free block where the payload fits in one line, splitting up 
+ * to line_pad bytes off its front as a free block to get there.
+ *
  */
 
 #include <stdio.h>
@@ -32,9 +82,15 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/mman.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#include "mm-classes.h"
 
 /*********************************************************
  * === User information ===
@@ -64,11 +120,30 @@ team_t team = {
 
 /* $begin mallocmacros */
 /* Basic constants and macros */
+#if defined(__LP64__) && !defined(MM_COMPACT)
+#define WSIZE       8       /* word size (bytes) */  
+#define DSIZE       16      /* doubleword size (bytes) */
+#else
 #define WSIZE       4       /* word size (bytes) */  
 #define DSIZE       8       /* doubleword size (bytes) */
-#define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) = 4096 byte = 4GB */
-#define OVERHEAD    8       /* overhead of header and footer (bytes) */
-#define MINSIZE     16      /* Minumum block size - header + footer + prev free + next free */
+#endif
+#ifdef MM_COMPACT
+#define LSIZE       4       /* size of a free list link (bytes) - heap offset */
+#define MAX_COMPACT_HEAP 0xffffffffUL /* offsets and tags must fit in 32 bits */
+#else
+#define LSIZE       sizeof(char *)  /* size of a free list link (bytes) */
+#endif
+#define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) = 4096 byte = 4KB */
+#define MAX_REQUEST ((size_t)-1 / 4) /* largest request, so block sizes and heap
+                                        extensions for it cannot overflow */
+#define STREAM_CLEAR (1<<16) /* mm_calloc clears blocks this big with streaming stores */
+/* largest block kept on a quick list (bytes) - that of the largest size class */
+#define QUICK_MAX   ((MM_CLASS_MAX + OVERHEAD + DSIZE-1) & ~(DSIZE-1))
+#define LINE_SIZE   64      /* cache line size (bytes) */
+#define LINE_SCAN   8       /* free blocks looked at past the first fit for one 
+                               that keeps a small payload within a line */
+#define OVERHEAD    DSIZE   /* overhead of header and footer (bytes) */
+#define MINSIZE     (OVERHEAD + 2*LSIZE) /* Minumum block size - header + footer + prev free + next free */
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))  /* MAXimum comparison */
 #define MIN(x, y) ((x) < (y)? (x) : (y))  /* Minimum comparison */ 
@@ -77,16 +152,33 @@ team_t team = {
 #define PACK(size, alloc)  ((size) | (alloc))
 
 /* Read and write a word at address p */
+#if WSIZE == 4
+#define GET(p)       (*(unsigned int *)(p))
+#define PUT(p, val)  (*(unsigned int *)(p) = (val))  
+#else
 #define GET(p)       (*(size_t *)(p))
 #define PUT(p, val)  (*(size_t *)(p) = (val))  
+#endif
 
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
-
-/* GET and PUT functions for the free list */
-#define GET_POINTER(p)      (*(size_t *)(p))
-#define PUT_POINTER(p, val) (*(size_t *)(p) = (size_t)(val))
+#define GET_QUICK(p) (GET(p) & 0x2)
+
+/* Tag bit of the blocks on a quick list, which stay allocated */
+#define QUICK       0x2
+
+/* GET and PUT functions for the free list. In compact mode a link is a 
+ * 32-bit offset from the start of the heap, offset 0 (the alignment 
+ * padding word) stands for NULL */
+#ifdef MM_COMPACT
+#define GET_POINTER(p)      (*(unsigned int *)(p) ? heap_lo + *(unsigned int *)(p) : NULL)
+#define PUT_POINTER(p, val) (*(unsigned int *)(p) = \
+                             (val) ? (unsigned int)((char *)(val) - heap_lo) : 0)
+#else
+#define GET_POINTER(p)      (*(char **)(p))
+#define PUT_POINTER(p, val) (*(char **)(p) = (char *)(val))
+#endif
 
 /* Given block ptr bp, compute address of its header and footer */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)  
@@ -96,32 +188,105 @@ team_t team = {
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-/* Given a ptr bp, return the next and previous free blocks in free list */
-#define NEXT_FREE(bp)  (HDRP(bp) + DSIZE)
-#define PREV_FREE(bp)  (HRDP(bp) + WSIZE)
-
-/* Value can be 0 for no debugging info - 1 for small info - 2 for print all lists  */
+/* Given a free block ptr bp, compute address of its next and previous free list links */
+#define NEXT_FREE(bp)  ((char *)(bp))
+#define PREV_FREE(bp)  ((char *)(bp) + LSIZE)
+
+/* Operation counters, only kept in -DMM_STATS builds */
+#ifdef MM_STATS
+static mm_stats_t op_stats;
+#define COUNT(field, n) (op_stats.field += (n))
+#else
+#define COUNT(field, n)
+#endif
+
+/* Debug level - 0 for no debugging info - 1 for checking - 2 for print all lists.
+ * Debug builds (-DMM_DEBUG, make mdriver64-debug) read it from the MM_DEBUG 
+ * environment variable or mm_set_debug; other builds have it fixed at 0, so
+ * the checks compile away. Their output goes to stderr, which is unbuffered,
+ * so printing it never calls malloc - under libmm-debug.so that would come
+ * back in while the heap is locked */
+#ifdef MM_DEBUG
+static int debug_level = 0;
+static int debug_set = 0;  /* set once MM_DEBUG or mm_set_debug was looked at */
+#define VERBOSE debug_level
+#else
 #define VERBOSE 0
+#endif
+
+/* At level 1 every operation checks the blocks it touched, and the whole
+ * heap is checked every check_sweep operations (0 for never) */
+#define CHECK_SWEEP 1024
+#define SHADOW_HEAP ((size_t)1 << 30) /* heap bytes the shadow bitmap covers */
 /* $end mallocmacros */
 
 /* Global variables */
 static char *heap_listp;  /* pointer to first block */
 static char *free_listp;  /* pointer to first free block */
+#ifdef MM_COMPACT
+static char *heap_lo;     /* base address free list offsets are relative to */
+#endif
+static char *zero_lo;     /* end of the highest block ever handed out - the heap 
+                           * above it is zero except for our own tags and links */
+
+/* Debug checking state, only used when VERBOSE is on */
+static unsigned char *shadow; /* one bit per DSIZE bytes of heap, set where an
+                               * allocated block is - kept apart from the heap */
+static char *shadow_base;     /* heap address of bit 0 */
+static size_t shadow_used;    /* bytes of shadow that may be non-zero */
+static int check_ops;         /* operations since the last full check */
+static int check_sweep = CHECK_SWEEP; /* operations between full checks */
+static size_t line_pad;       /* most bytes split off to keep a payload of up to
+                                 LINE_SIZE bytes in one cache line, 0 for off */
+static int line_set = 0;      /* set once MM_LINE_PAD or mm_set_line_pad was looked at */
+static int fit_policy = MM_FIT_FIRST; /* how find_fit searches (mm_set_fit) */
+static int fit_set = 0;       /* set once MM_FIT or mm_set_fit was looked at */
+static char *rover;           /* free block next fit starts at, or NULL */
+static char *quick[QUICK_MAX/DSIZE + 1]; /* quick lists, by block size / DSIZE */
+static int quick_len[QUICK_MAX/DSIZE + 1]; /* blocks on each of them */
+static int quick_count;       /* blocks on all of them */
+static int quick_limit = 0;   /* most blocks on one quick list, 0 for off */
+static int quick_set = 0;     /* set once MM_QUICK or mm_set_quick was looked at */
 
 /* function prototypes for internal helper routines */
+static inline size_t block_size(size_t size);
 static void *extend_heap(size_t words);
 static void place(void *bp, size_t asize);
+static void carve(void *bp, size_t asize, size_t k, void **ptrs);
+static int addr_cmp(const void *a, const void *b);
 static void *find_fit(size_t asize);
+static void *search_fit(size_t asize);
+static void *find_aligned_fit(size_t asize, size_t alignment);
+static void *find_line_fit(size_t asize, size_t size);
+static size_t align_front(void *bp, size_t alignment);
+static size_t line_front(void *bp, size_t size);
+static void *split_front(void *bp, size_t front);
 static void *coalesce(void *bp);
+static void insertFree(void *bp);
+static void removeFree(void *bp);
+static void replaceFree(void *bp, void *newbp);
+static void quick_push(void *bp, size_t size);
+static void *quick_pop(size_t size);
+static void *quick_release(int i);
+static void quick_flush(int i);
+static void *quick_flush_fit(size_t asize, size_t alignment);
+static void mark_used(void *bp);
+static void scrub_boundary(char *hp, char *end);
+static void clear_block(char *p, size_t n);
+static void shadow_init(void);
+static void shadow_mark(void *bp, size_t size, int set);
+static int shadow_bit(void *bp);
+static void check_op(void);
+static void check_block(void *bp);
 static void printblock(void *bp); 
 static void checkblock(void *bp);
 static void mm_checkheap(int verbose);
 
-/* single word (4) or double word (8) alignment */
-#define ALIGNMENT 8
+/* single word (4) or double word (8) alignment, 16 on 64-bit builds */
+#define ALIGNMENT DSIZE
 
 /* rounds up to the nearest multiple of ALIGNMENT */
-#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~0x7)
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1))
 
 #define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
 
@@ -134,20 +299,66 @@ static void mm_checkheap(int verbose);
  */
 int mm_init(void)
 {
+#ifdef MM_DEBUG
+    char *env;
+
+    /* MM_DEBUG=<level>[,<sweep>] */
+    if (!debug_set) {
+        debug_set = 1;
+        if ((env = getenv("MM_DEBUG")) != NULL)
+            sscanf(env, "%d,%d", &debug_level, &check_sweep);
+    }
+#endif
+    char *pad, *fit, *limit;
+
+    /* MM_LINE_PAD=<bytes> */
+    if (!line_set) {
+        line_set = 1;
+        if ((pad = getenv("MM_LINE_PAD")) != NULL)
+            line_pad = atoi(pad);
+    }
+
+    /* MM_FIT=first|next|next-wrap */
+    if (!fit_set) {
+        fit_set = 1;
+        if ((fit = getenv("MM_FIT")) != NULL)
+            fit_policy = !strcmp(fit, "next") ? MM_FIT_NEXT : 
+                !strcmp(fit, "next-wrap") ? MM_FIT_NEXT_WRAP : MM_FIT_FIRST;
+    }
+
+    /* MM_QUICK=<blocks per quick list> */
+    if (!quick_set) {
+        quick_set = 1;
+        if ((limit = getenv("MM_QUICK")) != NULL)
+            quick_limit = atoi(limit);
+    }
     if (VERBOSE == 2) {
-        printf("### Called mm_init ###\n");
+        fprintf(stderr, "### Called mm_init ###\n");
     }
     /* create the initial empty heap */
-    if ((heap_listp = mem_sbrk(4*WSIZE)) == NULL) {
+    if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1) {
         return -1;
     }
+#ifdef MM_COMPACT
+    heap_lo = heap_listp;
+#endif
 
     PUT(heap_listp, 0);                        /* alignment padding */
     PUT(heap_listp+WSIZE, PACK(OVERHEAD, 1));  /* prologue header - WZISE = padding */ 
     PUT(heap_listp+DSIZE, PACK(OVERHEAD, 1));  /* prologue footer */ 
     PUT(heap_listp+WSIZE+DSIZE, PACK(0, 1));   /* epilogue header */
+    zero_lo = MAX((char *)mem_zero_lo(), heap_listp+WSIZE+DSIZE);
     heap_listp += DSIZE;
-    free_listp = heap_listp + DSIZE;
+    free_listp = NULL;
+    rover = NULL;
+    memset(quick, 0, sizeof(quick));
+    memset(quick_len, 0, sizeof(quick_len));
+    quick_count = 0;
+#ifdef MM_STATS
+    memset(&op_stats, 0, sizeof(op_stats));
+#endif
+    if (VERBOSE)
+        shadow_init();
 
     /* Extend the empty heap with a free block of CHUNKSIZE bytes */
     if (extend_heap(CHUNKSIZE/WSIZE) == NULL) {
@@ -172,27 +383,32 @@ int mm_init(void)
 void *mm_malloc(size_t size)
 {
     if (VERBOSE == 2) {
-        printf("### Called mm_malloc ###\n");
+        fprintf(stderr, "### Called mm_malloc ###\n");
         mm_checkheap(VERBOSE);
     } else if (VERBOSE == 1) {
-        mm_checkheap(VERBOSE);
+        check_op();
     }
     size_t asize;      /* adjusted block size */
     size_t extendsize; /* amount to extend heap if no fit */
     char *bp;
 
-    /* Ignore spurious requests */
-    if (size <= 0)
+    /* Ignore spurious requests, and ones block_size would overflow on */
+    if (size <= 0 || size > MAX_REQUEST)
         return NULL;
 
     /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE)
-        asize = DSIZE + OVERHEAD;
-    else
-        asize = DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
+    asize = block_size(size);
+
+    /* Reuse a block freed to the quick list of this size */
+    if (asize <= QUICK_MAX && quick[asize/DSIZE] != NULL)
+        return quick_pop(asize);
     
     /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL) {
+    if (line_pad > 0 && size <= LINE_SIZE)
+        bp = find_line_fit(asize, size);
+    else
+        bp = find_fit(asize);
+    if (bp != NULL) {
         place(bp, asize);
         return bp;
     }
@@ -201,6 +417,8 @@ void *mm_malloc(size_t size)
     extendsize = MAX(asize,CHUNKSIZE);
     if ((bp = extend_heap(extendsize/WSIZE)) == NULL)
         return NULL;
+    if (line_pad > 0 && size <= LINE_SIZE && line_front(bp, size) <= line_pad)
+        bp = split_front(bp, line_front(bp, size));
     place(bp, asize);
     return bp;
 }
@@ -217,19 +435,75 @@ void *mm_malloc(size_t size)
 void mm_free(void *ptr)
 {
     if (VERBOSE == 2) {
-        printf("### Called mm_free ###\n");
+        fprintf(stderr, "### Called mm_free ###\n");
         mm_checkheap(VERBOSE);
     } else if (VERBOSE == 1) {
-        mm_checkheap(VERBOSE);
+        check_op();
     }
 
     size_t size = GET_SIZE(HDRP(ptr));
 
+    if (VERBOSE && GET_QUICK(HDRP(ptr))) {
+        fprintf(stderr, "Error: block %p was not allocated\n", ptr);
+        return;
+    }
+    if (size <= QUICK_MAX && quick_limit > 0) {
+        quick_push(ptr, size);
+        return;
+    }
+    if (VERBOSE)
+        shadow_mark(ptr, size, 0);
     PUT(HDRP(ptr), PACK(size, 0));
     PUT(FTRP(ptr), PACK(size, 0));
     coalesce(ptr);
 }
 
+/*
+ * mm_free_sized - Free a block whose payload size is known to the caller.
+ *
+ * size is the size that was passed to mm_malloc (or mm_realloc, etc.)
+ * for ptr. Since blocks are never bigger than their request needs, the
+ * block size is worked out from it instead of being read from the header,
+ * which is often a cache line the caller has not touched. In debug mode
+ * it is checked against the header.
+ */
+void mm_free_sized(void *ptr, size_t size)
+{
+    if (VERBOSE == 2) {
+        fprintf(stderr, "### Called mm_free_sized ###\n");
+        mm_checkheap(VERBOSE);
+    } else if (VERBOSE == 1) {
+        check_op();
+    }
+    size_t asize; /* adjusted block size */
+
+    /* No block is that big, leave the size to mm_free */
+    if (size > MAX_REQUEST) {
+        mm_free(ptr);
+        return;
+    }
+    asize = block_size(size);
+
+    if (VERBOSE && asize != GET_SIZE(HDRP(ptr))) {
+        fprintf(stderr, "Error: mm_free_sized(%p, %zu) but the block is %zu bytes\n",
+                ptr, size, (size_t)GET_SIZE(HDRP(ptr)));
+    }
+    if (VERBOSE && GET_QUICK(HDRP(ptr))) {
+        fprintf(stderr, "Error: block %p was not allocated\n", ptr);
+        return;
+    }
+    if (asize <= QUICK_MAX && quick_limit > 0) {
+        quick_push(ptr, asize);
+        return;
+    }
+    if (VERBOSE)
+        shadow_mark(ptr, asize, 0);
+
+    PUT(HDRP(ptr), PACK(asize, 0));
+    PUT((char *)ptr + asize - DSIZE, PACK(asize, 0));
+    coalesce(ptr);
+}
+
 /*
  * mm_realloc - Implemented simply in terms of mm_malloc and mm_free
  * when a program needs more memmory than it previosly requested
@@ -251,20 +525,21 @@ void mm_free(void *ptr)
 void *mm_realloc(void *ptr, size_t size)
 {
    if (VERBOSE == 2) {
-        printf("### Called mm_realloc ###\n");
+        fprintf(stderr, "### Called mm_realloc ###\n");
         mm_checkheap(VERBOSE);
     } else if (VERBOSE == 1) {
-        mm_checkheap(VERBOSE);
+        check_op();
     }
     void *newPtr = ptr;
+    void *nextPtr;   /* The block right behind the current one */
     size_t prevSize; /* Current size of the block to be changed */
     size_t asize;    /* Our calculated size of how big the block actually needs to be with header, footer, etc..  */
+    size_t newTotalSize;
 
-    if (size <= DSIZE) {
-        asize = DSIZE + OVERHEAD;
-    } else {
-        asize = DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
-    }
+    /* Too big to allocate, the old block is left as it is */
+    if (size > MAX_REQUEST)
+        return NULL;
+    asize = block_size(size);
 
     if (ptr == NULL) {
         return mm_malloc(size);
@@ -277,190 +552,597 @@ void *mm_realloc(void *ptr, size_t size)
 
     prevSize = GET_SIZE(HDRP(ptr));
 
-    if (prevSize == asize) {
+    /* The block is already big enough - give back the tail */
+    if (prevSize >= asize) {
+        if (prevSize > asize) {
+            PUT(HDRP(ptr), PACK(asize, 1));
+            PUT(FTRP(ptr), PACK(asize, 1));
+            void *tmpPtr = NEXT_BLKP(ptr);
+            PUT(HDRP(tmpPtr), PACK(prevSize - asize, 0));
+            PUT(FTRP(tmpPtr), PACK(prevSize - asize, 0));
+            if (VERBOSE)
+                shadow_mark(tmpPtr, prevSize - asize, 0);
+            coalesce(tmpPtr);
+        }
+        COUNT(realloc_inplace, 1);
         return ptr;
     }    
 
-    /* we are at the end of the heap */
-    if (!GET_SIZE(HDRP(ptr))) {
-        /* We extend the heap and extend the old block to the new heap size */
-        size_t extendSize = MAX(asize, CHUNKSIZE);
+    nextPtr = NEXT_BLKP(ptr);
 
-        newPtr = extend_heap(extendSize/WSIZE);
-        if (newPtr == NULL) {
-            return NULL;
+    /* We are at the end of the heap, or only a free block is behind us - 
+     * we extend the heap so the old block can grow in place */
+    if (!GET_SIZE(HDRP(nextPtr)) || 
+        (!GET_ALLOC(HDRP(nextPtr)) && !GET_SIZE(HDRP(NEXT_BLKP(nextPtr))))) {
+        newTotalSize = prevSize;
+        if (!GET_ALLOC(HDRP(nextPtr))) {
+            newTotalSize += GET_SIZE(HDRP(nextPtr));
         }
-        size_t newSize = extendSize + GET_SIZE(HDRP(ptr)) - asize;
-
-        PUT(HDRP(ptr), PACK(asize, 1));
-        PUT(FTRP(ptr), PACK(asize, 1));
-        //removeFree(ptr);
-        void *tmpPtr = NEXT_BLKP(ptr);
-        PUT(HDRP(tmpPtr), PACK(newSize, 0));
-        PUT(FTRP(tmpPtr), PACK(newSize, 0));
+        if (newTotalSize < asize) {
+            size_t extendSize = MAX(asize - newTotalSize, CHUNKSIZE);
 
-        // printf("After realloc\n");
-        //mm_checkheap(VERBOSE);
-        return ptr;
-    } 
+            if (extend_heap(extendSize/WSIZE) == NULL) {
+                return NULL;
+            }
+        }
+    }
 
     /* The next block is free - we try to extend to it*/
-    if (!GET_ALLOC(HDRP(NEXT_BLKP(ptr)))) {
-        newPtr = NEXT_BLKP(ptr);
-        size_t newTotalSize = GET_SIZE(HDRP(ptr)) + GET_SIZE(HDRP(newPtr));
+    if (!GET_ALLOC(HDRP(nextPtr))) {
+        newTotalSize = prevSize + GET_SIZE(HDRP(nextPtr));
 
-        if (newTotalSize >= asize)
-        {
+        if (newTotalSize >= asize) {
             size_t newSize = newTotalSize - asize;
 
-            if (newSize < MINSIZE) {
+            removeFree(nextPtr);
+            if (newSize == 0) {
                 PUT(HDRP(ptr), PACK(newTotalSize, 1));
                 PUT(FTRP(ptr), PACK(newTotalSize, 1));
-                //removeFree(ptr);
-
-                // printf("After realloc\n");
-                //mm_checkheap(VERBOSE);
-
-                return ptr;    
             }
             else {
                 PUT(HDRP(ptr), PACK(asize, 1));
                 PUT(FTRP(ptr), PACK(asize, 1));
-                //removeFree(ptr);
                 void *tmpPtr = NEXT_BLKP(ptr);
                 PUT(HDRP(tmpPtr), PACK(newSize, 0));
                 PUT(FTRP(tmpPtr), PACK(newSize, 0));
+                insertFree(tmpPtr);
+            }
+            mark_used(ptr);
+            if (VERBOSE) {
+                shadow_mark((char *)ptr + prevSize, GET_SIZE(HDRP(ptr)) - prevSize, 1);
+                check_block(ptr);
+            }
+            COUNT(realloc_inplace, 1);
+            return ptr;
+        }
+    }
 
-                // printf("After realloc\n");
-                //mm_checkheap(VERBOSE);
+    if ((newPtr = mm_malloc(size)) == NULL) {
+        return NULL;
+    }
 
-                return ptr;
-            }
-        } else if (!GET_SIZE(HDRP(newPtr))) {
-            size_t extendSize = MAX(asize, CHUNKSIZE);
-            extend_heap(extendSize/WSIZE);
-            size_t newSize = extendSize + newTotalSize - asize;
+    memcpy(newPtr, ptr, MIN(size, prevSize - OVERHEAD));
+    mm_free(ptr);
+    COUNT(realloc_copy, 1);
+    COUNT(realloc_copied, MIN(size, prevSize - OVERHEAD));
 
-            PUT(HDRP(ptr), PACK(asize, 1));
-            PUT(FTRP(ptr), PACK(asize, 1));
-            //removeFree(ptr);
-            void *tmpPtr = NEXT_BLKP(ptr);
-            PUT(HDRP(tmpPtr), PACK(newSize, 0));
-            PUT(FTRP(tmpPtr), PACK(newSize, 0));
+    return newPtr;
+}
 
-            //printf("After realloc\n");
-            //mm_checkheap(VERBOSE);
-            
-            return ptr;
+/*
+ * mm_memalign - Allocate a block with at least size bytes of payload 
+ * whose address is a multiple of alignment (a power of two).
+ *
+ * A free block that can hold an aligned payload is looked up in the free
+ * list. The misaligned front of it is split off as a free block of its
+ * own and the rest is placed like any other block, so the returned 
+ * pointer can be given to mm_free and mm_realloc as usual.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    if (VERBOSE == 2) {
+        fprintf(stderr, "### Called mm_memalign ###\n");
+        mm_checkheap(VERBOSE);
+    } else if (VERBOSE == 1) {
+        check_op();
+    }
+    size_t asize;      /* adjusted block size */
+    size_t extendsize; /* amount to extend heap if no fit */
+    char *bp;
+
+    if (size <= 0 || size > MAX_REQUEST || alignment == 0 || 
+        alignment > MAX_REQUEST || (alignment & (alignment - 1)))
+        return NULL;
+
+    /* Every block is already aligned this much */
+    if (alignment <= ALIGNMENT)
+        return mm_malloc(size);
+
+    /* Adjust block size to include overhead and alignment reqs. */
+    asize = block_size(size);
+
+    /* No fit found. Get enough memory for the block and the worst case 
+     * front, and search again since the new memory may have coalesced */
+    if ((bp = find_aligned_fit(asize, alignment)) == NULL) {
+        extendsize = MAX(asize + alignment + MINSIZE, CHUNKSIZE);
+        if (extend_heap(extendsize/WSIZE) == NULL)
+            return NULL;
+        if ((bp = find_aligned_fit(asize, alignment)) == NULL)
+            return NULL;
+    }
+
+    /* Split the misaligned front off as a free block */
+    bp = split_front(bp, align_front(bp, alignment));
+    place(bp, asize);
+    return bp;
+}
+
+/*
+ * mm_calloc - Allocate an array of nmemb elements of size bytes each,
+ * with the payload cleared to zero.
+ *
+ * Only the part of the block that has been handed out before is cleared.
+ * Memory at or above zero_lo comes straight from mem_sbrk and is still 
+ * zero, apart from the free list links we wrote at the start of the 
+ * free block the new block was carved from.
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+    if (VERBOSE == 2) {
+        fprintf(stderr, "### Called mm_calloc ###\n");
+        mm_checkheap(VERBOSE);
+    } else if (VERBOSE == 1) {
+        check_op();
+    }
+    char *clean = zero_lo; /* everything from here up is known to be zero */
+    size_t bytes;
+    char *bp, *end;
+
+    if (size != 0 && nmemb > (size_t)-1 / size)
+        return NULL;
+    bytes = nmemb * size;
+
+    if ((bp = mm_malloc(bytes)) == NULL)
+        return NULL;
+
+    end = MIN(bp + bytes, MAX(clean, bp + 2*LSIZE));
+    if (end > bp)
+        clear_block(bp, end - bp);
+    return bp;
+}
+
+/*
+ * mm_malloc_batch - Allocate n blocks with at least size bytes of payload
+ * each and store them in ptrs. Returns the number of blocks allocated, 
+ * which is less than n only if the heap could not be extended.
+ *
+ * The size is adjusted once, and the blocks are carved side by side out
+ * of a free block big enough for the rest of the batch, so there is one
+ * free list search and one split per run instead of one per block.
+ */
+size_t mm_malloc_batch(size_t size, size_t n, void **ptrs)
+{
+    if (VERBOSE == 2) {
+        fprintf(stderr, "### Called mm_malloc_batch ###\n");
+        mm_checkheap(VERBOSE);
+    } else if (VERBOSE == 1) {
+        check_op();
+    }
+    size_t asize;      /* adjusted block size */
+    size_t extendsize; /* amount to extend heap if no fit */
+    size_t done = 0;   /* blocks allocated so far */
+    size_t k;          /* blocks carved out of the current free block */
+    char *bp;
+
+    if (size <= 0 || size > MAX_REQUEST || n == 0)
+        return 0;
+
+    /* Adjust block size to include overhead and alignment reqs. */
+    asize = block_size(size);
+    if (n > (size_t)-1 / asize)
+        return 0;
+
+    while (done < n) {
+        /* Look for a free block that holds the rest of the batch (without
+         * flushing quick lists, as it usually fails), then for one that
+         * holds at least a single block, and only then get more memory */
+        if ((bp = search_fit((n - done) * asize)) == NULL &&
+            (bp = find_fit(asize)) == NULL) {
+            extendsize = MAX((n - done) * asize, CHUNKSIZE);
+            if ((bp = extend_heap(extendsize/WSIZE)) == NULL)
+                break;
         }
+        k = MIN(n - done, GET_SIZE(HDRP(bp)) / asize);
+        carve(bp, asize, k, ptrs + done);
+        done += k;
     }
+    return done;
+}
 
-    newPtr = mm_malloc(size);
+/*
+ * mm_free_batch - Free the n blocks in ptrs.
+ *
+ * The array is sorted by address in place. Each run of blocks that lie
+ * next to each other in the heap becomes one free block with a single
+ * coalesce, instead of merging the blocks one at a time.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+    if (VERBOSE == 2) {
+        fprintf(stderr, "### Called mm_free_batch ###\n");
+        mm_checkheap(VERBOSE);
+    } else if (VERBOSE == 1) {
+        check_op();
+    }
+    size_t i, j;
+    size_t size; /* size of the current run of neighbours */
 
-    memcpy(newPtr, ptr, (GET_SIZE(HDRP(ptr))));
-    mm_free(ptr);
+    if (VERBOSE) {
+        for (i = 0; i < n; i++)
+            shadow_mark(ptrs[i], GET_SIZE(HDRP(ptrs[i])), 0);
+    }
+    qsort(ptrs, n, sizeof(void *), addr_cmp);
+    for (i = 0; i < n; i = j) {
+        size = GET_SIZE(HDRP(ptrs[i]));
+        for (j = i + 1; j < n && (char *)ptrs[j] == (char *)ptrs[i] + size; j++)
+            size += GET_SIZE(HDRP(ptrs[j]));
+
+        PUT(HDRP(ptrs[i]), PACK(size, 0));
+        PUT(FTRP(ptrs[i]), PACK(size, 0));
+        coalesce(ptrs[i]);
+    }
+}
 
-    //printf("After realloc\n");
-    //mm_checkheap(VERBOSE);
+/*
+ * mm_usable_size - Return the number of payload bytes in the allocated
+ * block ptr, which can be more than was asked for when it was allocated.
+ */
+size_t mm_usable_size(void *ptr)
+{
+    return GET_SIZE(HDRP(ptr)) - OVERHEAD;
+}
 
-    return newPtr;
+/*
+ * mm_heap_walk - Call fn for every block between the prologue and the 
+ * epilogue. Slivers are reported as free blocks with no usable payload,
+ * and so are the blocks on the quick lists.
+ */
+void mm_heap_walk(mm_walk_fn fn, void *arg)
+{
+    char *bp;
+    size_t size;
+
+    for (bp = NEXT_BLKP(heap_listp); (size = GET_SIZE(HDRP(bp))) > 0; bp = NEXT_BLKP(bp))
+        fn(bp, size, size - OVERHEAD, GET_ALLOC(HDRP(bp)) && !GET_QUICK(HDRP(bp)), arg);
+}
+
+/*
+ * mm_set_debug - Set the debug level (0 off, 1 check, 2 print and check
+ * everything) and, for level 1, how many operations go between full heap
+ * checks. Overrides MM_DEBUG. Returns -1 if this is not a debug build.
+ */
+int mm_set_debug(int level, int sweep)
+{
+#ifdef MM_DEBUG
+    debug_set = 1;
+    debug_level = level;
+    check_sweep = sweep;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/*
+ * mm_stats - Copy the operation counters since mm_init to stats. Returns
+ * -1 if mm.c was built without -DMM_STATS.
+ */
+int mm_stats(mm_stats_t *stats)
+{
+#ifdef MM_STATS
+    *stats = op_stats;
+    return 0;
+#else
+    (void)stats;
+    return -1;
+#endif
+}
+
+/*
+ * mm_set_quick - Keep up to limit freed blocks of each small size on a
+ * quick list before they are coalesced (0 coalesces every block as it is
+ * freed). Overrides MM_QUICK.
+ */
+void mm_set_quick(int limit)
+{
+    quick_set = 1;
+    quick_limit = limit;
+}
+
+/*
+ * mm_set_fit - Pick how free blocks are searched: MM_FIT_FIRST from the
+ * head of the free list, MM_FIT_NEXT from the rover to the end of the 
+ * list, MM_FIT_NEXT_WRAP from the rover on around to where it started.
+ * Overrides MM_FIT.
+ */
+void mm_set_fit(int policy)
+{
+    fit_set = 1;
+    fit_policy = policy;
+    rover = NULL;
 }
 
+/*
+ * mm_set_line_pad - Keep payloads of up to a cache line from straddling
+ * two lines when that costs at most pad bytes of split off free space
+ * (0 turns it off). Overrides MM_LINE_PAD.
+ */
+void mm_set_line_pad(size_t pad)
+{
+    line_set = 1;
+    line_pad = pad;
+}
 
 /* 
  * The Coalesce function "merges" two or three blocks of memory that lie 
  * together. This is for the malloc to see how much memory really is 
  * available to allocate new memory.
+ * The resulting free block is put at the front of the free list.
  */
 static void *coalesce(void *bp) 
 {
     if (VERBOSE == 2) {
-        printf("### Called coalesce ###\n");
-        mm_checkheap(VERBOSE);
-    } else if (VERBOSE == 1) {
-        mm_checkheap(VERBOSE);
+        fprintf(stderr, "### Called coalesce ###\n");
     }
     size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     size_t size = GET_SIZE(HDRP(bp));
+    char *lhp = HDRP(bp);            /* boundary with the block on the left */
+    char *rhp = HDRP(NEXT_BLKP(bp)); /* boundary with the block on the right */
 
     /* Case 1: if both are allocated (on the left and on the right next 
      * to the current block)*/
     if (prev_alloc && next_alloc) {
-        return bp;
+        /* nothing to merge */
+        COUNT(coalesce[0], 1);
     }
 
     /* Case 2: if the block on the left is allocated but the block on 
      * the right is free */
     else if (prev_alloc && !next_alloc) {
+        COUNT(coalesce[1], 1);
+        removeFree(NEXT_BLKP(bp));
         size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
         PUT(HDRP(bp), PACK(size, 0));
         PUT(FTRP(bp), PACK(size,0));
+        scrub_boundary(rhp, FTRP(bp));
     }
 
     /* Case 3: if the block on the left is free but the block on the 
      * right is allocated*/
     else if (!prev_alloc && next_alloc) {
+        COUNT(coalesce[2], 1);
+        removeFree(PREV_BLKP(bp));
         size += GET_SIZE(HDRP(PREV_BLKP(bp)));
         PUT(FTRP(bp), PACK(size, 0));
         PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
         bp = PREV_BLKP(bp);
+        scrub_boundary(lhp, FTRP(bp));
     }
 
     /* Case 4: if both the block on the right and the block on the left 
      * to the current block are free*/
     else {
+        COUNT(coalesce[3], 1);
+        removeFree(PREV_BLKP(bp));
+        removeFree(NEXT_BLKP(bp));
         size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
             GET_SIZE(FTRP(NEXT_BLKP(bp)));
         PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
         PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
         bp = PREV_BLKP(bp);
+        scrub_boundary(lhp, FTRP(bp));
+        scrub_boundary(rhp, FTRP(bp));
     }
 
+    insertFree(bp);
+    if (VERBOSE)
+        check_block(bp);
     return bp;
 }
 
 /* 
- * find_fit - Find a fit for a block with asize bytes 
+ * find_fit - Find a fit for a block with asize bytes, on the free list
+ * or else among the quick blocks big enough to hold it
  */
 static void *find_fit(size_t asize)
 {
-    /* first fit search */
+    char *bp;
+
+    if ((bp = search_fit(asize)) != NULL)
+        return bp;
+    return quick_flush_fit(asize, ALIGNMENT);
+}
+
+/* 
+ * search_fit - Search the free list for a fit for a block with asize 
+ * bytes, leaving the quick lists alone
+ */
+static void *search_fit(size_t asize)
+{
+    /* first fit search, or next fit from the rover */
     if (VERBOSE == 2) {
-        printf("### called find_fit ###");
-        mm_checkheap(VERBOSE);
-    } else if (VERBOSE == 1) {
-        mm_checkheap(VERBOSE);
+        fprintf(stderr, "### called find_fit ###\n");
     }
-    void *bp;
-
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
-        if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp)))) {
+    char *bp, *start = free_listp;
+
+    COUNT(fits, 1);
+    if (fit_policy != MM_FIT_FIRST && rover != NULL)
+        start = rover;
+    for (bp = start; bp != NULL; bp = GET_POINTER(NEXT_FREE(bp))) {
+        COUNT(fit_visits, 1);
+        if (asize <= GET_SIZE(HDRP(bp))) {
             return bp;
         }
     }
+
+    /* Wrap around and search the part of the list before the rover */
+    if (fit_policy == MM_FIT_NEXT_WRAP) {
+        for (bp = free_listp; bp != start; bp = GET_POINTER(NEXT_FREE(bp))) {
+            COUNT(fit_visits, 1);
+            if (asize <= GET_SIZE(HDRP(bp))) {
+                return bp;
+            }
+        }
+    }
+
     return NULL; /* no fit */
 }
 
 /* 
+ * find_aligned_fit - Find a free block that can hold a block of asize 
+ * bytes whose payload is aligned to alignment
+ */
+static void *find_aligned_fit(size_t asize, size_t alignment)
+{
+    char *bp;
+
+    COUNT(fits, 1);
+    for (bp = free_listp; bp != NULL; bp = GET_POINTER(NEXT_FREE(bp))) {
+        COUNT(fit_visits, 1);
+        if (align_front(bp, alignment) + asize <= GET_SIZE(HDRP(bp))) {
+            return bp;
+        }
+    }
+    return quick_flush_fit(asize, alignment);
+}
+
+/* 
+ * find_line_fit - Find a fit for a block with asize bytes, preferring one
+ * where a payload of size bytes stays within one cache line, with at most
+ * line_pad bytes split off its front. Looks at LINE_SCAN blocks past the
+ * first fit before settling for it. Returns the block after the split.
+ */
+static void *find_line_fit(size_t asize, size_t size)
+{
+    char *bp, *first = NULL;
+    size_t front;
+    int scanned = 0;
+
+    COUNT(fits, 1);
+    for (bp = free_listp; bp != NULL && scanned <= LINE_SCAN; 
+         bp = GET_POINTER(NEXT_FREE(bp))) {
+        COUNT(fit_visits, 1);
+        if (asize > GET_SIZE(HDRP(bp)))
+            continue;
+        front = line_front(bp, size);
+        if (front <= line_pad && front + asize <= GET_SIZE(HDRP(bp)))
+            return split_front(bp, front);
+        if (first == NULL)
+            first = bp;
+        scanned++;
+    }
+    if (first == NULL)
+        return quick_flush_fit(asize, ALIGNMENT);
+    return first;
+}
+
+/* 
+ * align_front - The number of bytes to split off the front of free block
+ * bp so the rest of it starts on an alignment boundary. The front becomes
+ * a free block of its own, so it is either 0 or at least MINSIZE.
+ */
+static size_t align_front(void *bp, size_t alignment)
+{
+    size_t front = (alignment - ((size_t)bp & (alignment - 1))) & (alignment - 1);
+
+    if (front != 0 && front < MINSIZE)
+        front += alignment;
+    return front;
+}
+
+/* 
+ * line_front - The number of bytes to split off the front of free block
+ * bp so a payload of size bytes at the rest of it does not cross a cache
+ * line. Like align_front, it is either 0 or at least MINSIZE.
+ */
+static size_t line_front(void *bp, size_t size)
+{
+    size_t offset = (size_t)bp & (LINE_SIZE - 1);
+    size_t front;
+
+    if (offset + size <= LINE_SIZE)
+        return 0;
+    front = LINE_SIZE - offset;
+    if (front < MINSIZE)
+        front += LINE_SIZE;
+    return front;
+}
+
+/* 
+ * split_front - Split front bytes off free block bp as a free block of 
+ * their own and return the free block that follows them
+ */
+static void *split_front(void *bp, size_t front)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+
+    if (front == 0)
+        return bp;
+    removeFree(bp);
+    PUT(HDRP(bp), PACK(front, 0));
+    PUT(FTRP(bp), PACK(front, 0));
+    insertFree(bp);
+    bp = NEXT_BLKP(bp);
+    PUT(HDRP(bp), PACK(csize - front, 0));
+    PUT(FTRP(bp), PACK(csize - front, 0));
+    insertFree(bp);
+    return bp;
+}
+
+/*
+ * block_size - The size of the block for a request of size bytes, with
+ * header, footer and alignment. Requests of up to MM_CLASS_MAX bytes
+ * first round up to their size class (mm-classes.h, made by mkclasses
+ * from the traces), so freed small blocks serve every later request
+ * of the same class.
+ *
+ * Every allocation starts here, so there are no branches or divides: 
+ * the class table is read for every size, clamped to its end, and the
+ * class taken or not with a conditional move. Rounding up to DSIZE is 
+ * an add and a mask, and requests of up to DSIZE need no case of their
+ * own, as they round up to DSIZE + OVERHEAD anyway. sizebench times it.
+ */
+static inline size_t block_size(size_t size)
+{
+    size_t class = mm_class_size[mm_class_index[(MIN(size, MM_CLASS_MAX) + 7) >> 3]];
+
+    size = (size <= MM_CLASS_MAX) ? class : size;
+    return (size + OVERHEAD + (DSIZE-1)) & ~(size_t)(DSIZE-1);
+}
+
+/*
  * extend_heap - Extend heap with free block and return its block pointer
  */
 /* $begin mmextendheap */
 static void *extend_heap(size_t words) 
 {
     if (VERBOSE == 2) {
-        printf("### Called extend_heap ###\n");
-        mm_checkheap(VERBOSE);
-    } else if (VERBOSE == 1) {
-        mm_checkheap(VERBOSE);
+        fprintf(stderr, "### Called extend_heap ###\n");
     }
     char *bp;
     size_t size;
         
     /* Allocate an even number of words to maintain alignment */
     size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
+#ifdef MM_COMPACT
+    if (mem_heapsize() + size > MAX_COMPACT_HEAP)
+        return NULL;
+#endif
     if ((bp = mem_sbrk(size)) == (void *)-1) 
         return NULL;
+    COUNT(extends, 1);
+    COUNT(extend_bytes, size);
 
     /* Initialize free block header/footer and the epilogue header */
     PUT(HDRP(bp), PACK(size, 0));         /* free block header */
@@ -474,7 +1156,7 @@ static void *extend_heap(size_t words)
 
 /* 
  * place - Place block of asize bytes at start of free block bp 
- *         and split if remainder would be at least minimum block size
+ *         and split off the remainder, which may be a sliver
  */
 /* $begin mmplace */
 /* $begin mmplace-proto */
@@ -482,40 +1164,414 @@ static void place(void *bp, size_t asize)
 /* $end mmplace-proto */
 {
     if (VERBOSE == 2) {
-        printf("### Called place ###\n");
-        mm_checkheap(VERBOSE);
-    } else if (VERBOSE == 1) {
-        mm_checkheap(VERBOSE);
+        fprintf(stderr, "### Called place ###\n");
     }
     size_t csize = GET_SIZE(HDRP(bp));   
-
-    if ((csize - asize) >= (DSIZE + OVERHEAD)) { 
+    char *rest = (char *)bp + asize;
+    int next_fit = fit_policy != MM_FIT_FIRST && csize - asize >= MINSIZE;
+
+    /* Next fit carries on right after this block: the remainder takes
+     * its place on the free list and the rover is left there */
+    if (next_fit) {
+        replaceFree(bp, rest);
+        rover = rest;
+    }
+    else
+        removeFree(bp);
+    if (csize > asize) { 
+        COUNT(splits, 1);
         PUT(HDRP(bp), PACK(asize, 1));
         PUT(FTRP(bp), PACK(asize, 1));
-        bp = NEXT_BLKP(bp);
+        mark_used(bp);
+        if (VERBOSE)
+            shadow_mark(bp, asize, 1);
+        bp = rest;
         PUT(HDRP(bp), PACK(csize-asize, 0));
         PUT(FTRP(bp), PACK(csize-asize, 0));
+        if (!next_fit)
+            insertFree(bp);
     }
     else { 
         PUT(HDRP(bp), PACK(csize, 1));
         PUT(FTRP(bp), PACK(csize, 1));
+        mark_used(bp);
+        if (VERBOSE)
+            shadow_mark(bp, csize, 1);
     }
+    if (VERBOSE)
+        check_block(bp);
 }
 /* $end mmplace */
 
+/* 
+ * carve - Place k blocks of asize bytes side by side at the start of free
+ *         block bp and store their payload pointers in ptrs. Only the
+ *         last block is split from the rest of bp, like place does.
+ */
+static void carve(void *bp, size_t asize, size_t k, void **ptrs)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t i;
+
+    removeFree(bp);
+    for (i = 0; i < k - 1; i++) {
+        PUT(HDRP(bp), PACK(asize, 1));
+        PUT(FTRP(bp), PACK(asize, 1));
+        if (VERBOSE)
+            shadow_mark(bp, asize, 1);
+        ptrs[i] = bp;
+        bp = NEXT_BLKP(bp);
+        csize -= asize;
+    }
+
+    PUT(HDRP(bp), PACK(csize, 0));
+    PUT(FTRP(bp), PACK(csize, 0));
+    insertFree(bp);
+    place(bp, asize);
+    ptrs[k - 1] = bp;
+}
+
+/* addr_cmp - qsort comparison of two block pointers by address */
+static int addr_cmp(const void *a, const void *b)
+{
+    char *x = *(char * const *)a;
+    char *y = *(char * const *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* insertFree - Inserts a free block to the front of the free list,
+ * unless it is a sliver too small to hold the links */
+/* $begin mminsertFree */
+static void insertFree(void *bp)
+{
+    if (GET_SIZE(HDRP(bp)) < MINSIZE)
+        return;
+    PUT_POINTER(NEXT_FREE(bp), free_listp);
+    PUT_POINTER(PREV_FREE(bp), NULL);
+    if (free_listp != NULL) {
+        PUT_POINTER(PREV_FREE(free_listp), bp);
+    }
+    free_listp = bp;
+}
+/* $end mminsertFree */
+
+/* removeFree - Removes a free block from the free list to be allocated */
+/* $begin mmremoveFree */
+static void removeFree(void *bp)
+{
+    if (GET_SIZE(HDRP(bp)) < MINSIZE)
+        return;
+    char *next = GET_POINTER(NEXT_FREE(bp));
+    char *prev = GET_POINTER(PREV_FREE(bp));
+
+    if (bp == rover)
+        rover = next;
+    if (prev == NULL) {
+        free_listp = next;
+    } else {
+        PUT_POINTER(NEXT_FREE(prev), next);
+    }
+    if (next != NULL) {
+        PUT_POINTER(PREV_FREE(next), prev);
+    }
+}
+/* $end mmremoveFree */
+
+/* replaceFree - Puts free block newbp where bp is on the free list */
+static void replaceFree(void *bp, void *newbp)
+{
+    char *next = GET_POINTER(NEXT_FREE(bp));
+    char *prev = GET_POINTER(PREV_FREE(bp));
+
+    PUT_POINTER(NEXT_FREE(newbp), next);
+    PUT_POINTER(PREV_FREE(newbp), prev);
+    if (prev == NULL) {
+        free_listp = newbp;
+    } else {
+        PUT_POINTER(NEXT_FREE(prev), newbp);
+    }
+    if (next != NULL) {
+        PUT_POINTER(PREV_FREE(next), newbp);
+    }
+}
+
+/*
+ * quick_push - Put the allocated block bp of size bytes on the quick list
+ * of its size, first coalescing the blocks already there if it is full
+ */
+static void quick_push(void *bp, size_t size)
+{
+    int i = size / DSIZE;
+
+    if (quick_len[i] >= quick_limit)
+        quick_flush(i);
+    if (VERBOSE)
+        shadow_mark(bp, size, 0);
+    PUT(HDRP(bp), PACK(size, QUICK | 1));
+    PUT(FTRP(bp), PACK(size, QUICK | 1));
+    PUT_POINTER(NEXT_FREE(bp), quick[i]);
+    quick[i] = bp;
+    quick_len[i]++;
+    quick_count++;
+    if (VERBOSE)
+        check_block(bp);
+}
+
+/* quick_pop - Take a block of size bytes off its quick list and return it */
+static void *quick_pop(size_t size)
+{
+    int i = size / DSIZE;
+    char *bp = quick[i];
+
+    quick[i] = GET_POINTER(NEXT_FREE(bp));
+    quick_len[i]--;
+    quick_count--;
+    PUT(HDRP(bp), PACK(size, 1));
+    PUT(FTRP(bp), PACK(size, 1));
+    COUNT(quick_hits, 1);
+    if (VERBOSE) {
+        shadow_mark(bp, size, 1);
+        check_block(bp);
+    }
+    return bp;
+}
+
+/* 
+ * quick_release - Free and coalesce the first block on quick list i.
+ * Returns the free block it became part of.
+ */
+static void *quick_release(int i)
+{
+    char *bp = quick[i];
+    size_t size = i * DSIZE;
+
+    quick[i] = GET_POINTER(NEXT_FREE(bp));
+    quick_len[i]--;
+    quick_count--;
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+    return coalesce(bp);
+}
+
+/* quick_flush - Free and coalesce every block on quick list i */
+static void quick_flush(int i)
+{
+    while (quick[i] != NULL)
+        quick_release(i);
+    COUNT(quick_flushes, 1);
+}
+
+/* 
+ * quick_flush_fit - A fit search failed. Free and coalesce the quick 
+ * blocks of at least asize bytes, smallest first, until one of them 
+ * becomes part of a free block that holds asize bytes at the given 
+ * alignment, and return that block. Smaller quick blocks could only 
+ * make a fit by coalescing with their neighbours, so they are left for
+ * their lists to fill up. Returns NULL if there is no fit.
+ */
+static void *quick_flush_fit(size_t asize, size_t alignment)
+{
+    char *bp;
+    size_t i;
+
+    if (quick_count == 0)
+        return NULL;
+    for (i = (asize + DSIZE-1) / DSIZE; i <= QUICK_MAX/DSIZE; i++) {
+        if (quick[i] == NULL)
+            continue;
+        COUNT(quick_flushes, 1);
+        while (quick[i] != NULL) {
+            bp = quick_release(i);
+            if (align_front(bp, alignment) + asize <= GET_SIZE(HDRP(bp)))
+                return bp;
+        }
+    }
+    return NULL;
+}
+
+/* mark_used - Move zero_lo past the block bp that is being handed out */
+static void mark_used(void *bp)
+{
+    char *end = HDRP(NEXT_BLKP(bp));
+
+    if (end > zero_lo)
+        zero_lo = end;
+}
+
+/*
+ * scrub_boundary - Two free blocks were merged at hp, the header of the 
+ * right hand one. Zero the footer, header and free list links left in
+ * the middle of the merged block if they lie above zero_lo, so the 
+ * memory there stays zero for mm_calloc. end is the footer of the merged
+ * block, which a sliver on the right would otherwise reach into.
+ */
+static void scrub_boundary(char *hp, char *end)
+{
+    char *lo = hp - WSIZE;
+    char *hi = MIN(hp + WSIZE + 2*LSIZE, end);
+
+    if (hi <= zero_lo)
+        return;
+    if (lo < zero_lo)
+        lo = zero_lo;
+    memset(lo, 0, hi - lo);
+}
+
+/*
+ * clear_block - Zero n bytes at p. Large blocks are cleared with 
+ * non-temporal SSE2 stores that do not pull the block into the cache.
+ */
+static void clear_block(char *p, size_t n)
+{
+#ifdef __SSE2__
+    if (n >= STREAM_CLEAR) {
+        __m128i zero = _mm_setzero_si128();
+        char *end = p + n;
+        char *q = (char *)(((size_t)p + 15) & ~(size_t)15);
+
+        memset(p, 0, q - p);
+        for (; q + 64 <= end; q += 64) {
+            _mm_stream_si128((__m128i *)q, zero);
+            _mm_stream_si128((__m128i *)(q + 16), zero);
+            _mm_stream_si128((__m128i *)(q + 32), zero);
+            _mm_stream_si128((__m128i *)(q + 48), zero);
+        }
+        _mm_sfence();
+        memset(q, 0, end - q);
+        return;
+    }
+#endif
+    memset(p, 0, n);
+}
+
+/*
+ * shadow_init - Set up an empty shadow bitmap for a new heap. The bitmap
+ * is mapped on first use and only reserves address space until touched.
+ */
+static void shadow_init(void)
+{
+    if (shadow == NULL) {
+        shadow = mmap(NULL, SHADOW_HEAP / DSIZE / 8, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (shadow == MAP_FAILED) {
+            shadow = NULL;
+            return;
+        }
+    }
+    memset(shadow, 0, shadow_used);
+    shadow_used = 0;
+    shadow_base = mem_heap_lo();
+    check_ops = 0;
+}
+
+/*
+ * shadow_mark - Set (set = 1) or clear the shadow bits of the size bytes
+ * of blocks starting at bp, and complain if any of them already was in
+ * that state: a block handed out twice, or freed when it was not in use.
+ */
+static void shadow_mark(void *bp, size_t size, int set)
+{
+    size_t i = ((char *)bp - shadow_base) / DSIZE;
+    size_t end = i + size / DSIZE;
+    unsigned char full = set ? 0xff : 0;
+    int bad = 0;
+
+    if (shadow == NULL || (char *)bp < shadow_base || end > SHADOW_HEAP / DSIZE)
+        return;
+
+    /* Whole bytes where we can, single bits at the ends */
+    while (i < end) {
+        if ((i & 7) == 0 && i + 8 <= end) {
+            bad |= shadow[i >> 3] != (unsigned char)~full;
+            shadow[i >> 3] = full;
+            i += 8;
+        } else {
+            bad |= ((shadow[i >> 3] >> (i & 7)) & 1) == set;
+            shadow[i >> 3] = (shadow[i >> 3] & ~(1 << (i & 7))) | (set << (i & 7));
+            i++;
+        }
+    }
+    if ((end + 7) / 8 > shadow_used)
+        shadow_used = (end + 7) / 8;
+
+    if (bad && set)
+        fprintf(stderr, "Error: block %p overlaps an allocated block\n", bp);
+    else if (bad)
+        fprintf(stderr, "Error: block %p was not allocated\n", bp);
+}
+
+/* shadow_bit - The shadow bit of the first DSIZE bytes of block bp */
+static int shadow_bit(void *bp)
+{
+    size_t i = ((char *)bp - shadow_base) / DSIZE;
+
+    if (shadow == NULL || i >= SHADOW_HEAP / DSIZE)
+        return GET_ALLOC(HDRP(bp));
+    return (shadow[i >> 3] >> (i & 7)) & 1;
+}
+
+/* check_op - Count an operation and check the whole heap every check_sweep */
+static void check_op(void)
+{
+    if (check_sweep > 0 && ++check_ops >= check_sweep) {
+        check_ops = 0;
+        mm_checkheap(0);
+    }
+}
+
+/*
+ * check_block - Check the block bp an operation just changed: its tags
+ * and those of its neighbours, that it was coalesced, its free list 
+ * links and that the shadow bitmap agrees it is allocated or free.
+ */
+static void check_block(void *bp)
+{
+    char *prev = PREV_BLKP(bp);
+    char *next = NEXT_BLKP(bp);
+    char *link;
+
+    checkblock(bp);
+    checkblock(prev);
+    if (GET_SIZE(HDRP(next)) > 0)
+        checkblock(next);
+    else if (!GET_ALLOC(HDRP(next)))
+        fprintf(stderr, "Bad epilogue header\n");
+    if (shadow != NULL &&
+        shadow_bit(bp) != (GET_ALLOC(HDRP(bp)) && !GET_QUICK(HDRP(bp))))
+        fprintf(stderr, "Error: shadow bitmap disagrees with the header of %p\n",
+                bp);
+
+    if (GET_ALLOC(HDRP(bp)))
+        return;
+    if (!GET_ALLOC(HDRP(prev)) || !GET_ALLOC(HDRP(next)))
+        fprintf(stderr, "Error: free block %p was not coalesced\n", bp);
+    if (GET_SIZE(HDRP(bp)) < MINSIZE)
+        return;
+    link = GET_POINTER(NEXT_FREE(bp));
+    if (link != NULL && GET_POINTER(PREV_FREE(link)) != bp)
+        fprintf(stderr, "Error: free list links of %p are inconsistent\n", bp);
+    link = GET_POINTER(PREV_FREE(bp));
+    if (link == NULL ? free_listp != (char *)bp : GET_POINTER(NEXT_FREE(link)) != bp)
+        fprintf(stderr, "Error: free list links of %p are inconsistent\n", bp);
+}
+
 /* Debug helper functions if verbose is on */
 void mm_checkheap(int verbose) 
 {
     if (verbose == 2) {
-        printf("### Checking heap... ###");
+        fprintf(stderr, "### Checking heap... ###");
     }
     char *bp = heap_listp;
+    int free_blocks = 0; /* free blocks seen in the heap but not on the list */
+    int quick_blocks = 0; /* ditto for the quick lists */
+    int i;
 
     if (verbose == 2)
-        printf("Heap (%p):\n", heap_listp);
+        fprintf(stderr, "Heap (%p):\n", heap_listp);
 
     if ((GET_SIZE(HDRP(heap_listp)) != DSIZE) || !GET_ALLOC(HDRP(heap_listp))) {
-        printf("Bad prologue header\n");
+        fprintf(stderr, "Bad prologue header\n");
     }
     checkblock(heap_listp);
 
@@ -523,12 +1579,62 @@ void mm_checkheap(int verbose)
         if (verbose == 2) 
             printblock(bp);
         checkblock(bp);
+        if (!GET_ALLOC(HDRP(bp)) && GET_SIZE(HDRP(bp)) >= MINSIZE)
+            free_blocks++;
+        if (GET_QUICK(HDRP(bp)))
+            quick_blocks++;
+        if (shadow != NULL && bp != heap_listp && 
+            shadow_bit(bp) != (GET_ALLOC(HDRP(bp)) && !GET_QUICK(HDRP(bp))))
+            fprintf(stderr, "Error: shadow bitmap disagrees with the header of %p\n",
+                    bp);
     }
      
     if (verbose == 2)
         printblock(bp);
     if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
-        printf("Bad epilogue header\n");
+        fprintf(stderr, "Bad epilogue header\n");
+
+    /* Every block on the free list must be free and properly linked,
+     * and every free block big enough to be on it must be there */
+    for (bp = free_listp; bp != NULL; bp = GET_POINTER(NEXT_FREE(bp))) {
+        free_blocks--;
+        if (bp < (char *)mem_heap_lo() || bp > (char *)mem_heap_hi()) {
+            fprintf(stderr, "Error: free list pointer %p outside heap\n", bp);
+            break;
+        }
+        if (GET_ALLOC(HDRP(bp)))
+            fprintf(stderr, "Error: %p is on the free list but allocated\n", bp);
+        if (GET_POINTER(NEXT_FREE(bp)) != NULL && 
+            GET_POINTER(PREV_FREE(GET_POINTER(NEXT_FREE(bp)))) != bp)
+            fprintf(stderr, "Error: free list links of %p are inconsistent\n",
+                    bp);
+    }
+    if (bp == NULL && free_blocks != 0)
+        fprintf(stderr, "Error: %d free blocks are missing from the free list\n",
+                free_blocks);
+
+    /* Every block on a quick list must have the size of the list and
+     * the QUICK bit, and every block with that bit must be on one */
+    for (i = 0; i <= QUICK_MAX/DSIZE; i++) {
+        for (bp = quick[i]; bp != NULL; bp = GET_POINTER(NEXT_FREE(bp))) {
+            if (quick_blocks-- == 0) {
+                fprintf(stderr, "Error: quick list %d is longer than the heap has "
+                        "blocks for\n", i);
+                break;
+            }
+            if (GET_SIZE(HDRP(bp)) != (size_t)i * DSIZE || !GET_QUICK(HDRP(bp)))
+                fprintf(stderr, "Error: %p is on the wrong quick list\n", bp);
+        }
+    }
+    if (quick_blocks > 0)
+        fprintf(stderr, "Error: %d quick blocks are missing from the quick lists\n",
+                quick_blocks);
+
+    /* The rover must be on the free list */
+    for (bp = free_listp; bp != NULL && bp != rover; bp = GET_POINTER(NEXT_FREE(bp)))
+        ;
+    if (bp != rover)
+        fprintf(stderr, "Error: rover %p is not on the free list\n", rover);
 }
 
 static void printblock(void *bp) 
@@ -541,20 +1647,19 @@ static void printblock(void *bp)
     falloc = GET_ALLOC(FTRP(bp));  
     
     if (hsize == 0) {
-        printf("%p: EOL\n", bp);
+        fprintf(stderr, "%p: EOL\n", bp);
         return;
     }
 
-    printf("%p: header: [%d:%c] footer: [%d:%c]\n", bp, 
-           hsize, (halloc ? 'a' : 'f'), 
-           fsize, (falloc ? 'a' : 'f')); 
+    fprintf(stderr, "%p: header: [%zu:%c] footer: [%zu:%c]\n", bp, 
+            hsize, (halloc ? 'a' : 'f'), 
+            fsize, (falloc ? 'a' : 'f')); 
 }
 
 static void checkblock(void *bp) 
 {
-    if ((size_t)bp % 8)
-        printf("Error: %p is not doubleword aligned\n", bp);
+    if ((size_t)bp % ALIGNMENT)
+        fprintf(stderr, "Error: %p is not doubleword aligned\n", bp);
     if (GET(HDRP(bp)) != GET(FTRP(bp)))
-        printf("Error: header does not match footer\n");
+        fprintf(stderr, "Error: header does not match footer\n");
 }
-
@@ -3,7 +3,55 @@
 extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
+extern void mm_free_sized(void *ptr, size_t size);
 extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern void *mm_calloc(size_t nmemb, size_t size);
+extern size_t mm_malloc_batch(size_t size, size_t n, void **ptrs);
+extern void mm_free_batch(void **ptrs, size_t n);
+extern size_t mm_usable_size(void *ptr);
+extern int mm_set_debug(int level, int sweep);
+
+/* What mm.c's operations cost since mm_init, counted in -DMM_STATS builds */
+typedef struct {
+    unsigned long fits;            /* free list searches */
+    unsigned long fit_visits;      /* free blocks looked at by them */
+    unsigned long splits;          /* free blocks split to place a block */
+    unsigned long coalesce[4];     /* frees by coalesce case: no free
+                                      neighbour, right, left, both */
+    unsigned long extends;         /* heap extensions */
+    unsigned long extend_bytes;    /* bytes they added */
+    unsigned long realloc_inplace; /* reallocs that kept their block */
+    unsigned long realloc_copy;    /* reallocs that moved it */
+    unsigned long realloc_copied;  /* bytes those copied */
+    unsigned long quick_hits;      /* mallocs served from a quick list */
+    unsigned long quick_flushes;   /* quick lists coalesced */
+} mm_stats_t;
+extern int mm_stats(mm_stats_t *stats);
+extern void mm_set_line_pad(size_t pad);
+
+/* Free block search policies for mm_set_fit */
+#define MM_FIT_FIRST     0  /* first fit from the head of the free list */
+#define MM_FIT_NEXT      1  /* next fit from a roving pointer */
+#define MM_FIT_NEXT_WRAP 2  /* next fit, wrapping around to the head */
+extern void mm_set_fit(int policy);
+
+/* Freed small blocks can wait on quick lists of up to this many blocks
+ * per size before they are coalesced (mm_set_quick, off by default) */
+#define MM_QUICK_LIMIT 8
+extern void mm_set_quick(int limit);
+
+/* Calls fn for every block in the heap, in address order, with its size,
+ * the payload bytes it can hold and whether it is allocated */
+typedef void (*mm_walk_fn)(void *bp, size_t size, size_t usable, int alloc, void *arg);
+extern void mm_heap_walk(mm_walk_fn fn, void *arg);
+
+/* Arenas (mm-arena.c) - bump allocation in chunks taken from mm_malloc */
+typedef struct mm_arena mm_arena_t;
+extern mm_arena_t *mm_arena_create(void);
+extern void *mm_arena_alloc(mm_arena_t *arena, size_t size);
+extern void mm_arena_reset(mm_arena_t *arena);
+extern void mm_arena_destroy(mm_arena_t *arena);
 
 
 /* 
@@ -23,3 +71,32 @@ typedef struct {
 
 extern team_t team;
 
+
+/*
+ * Each allocator variant linked into the driver is described by one of
+ * these. mm.c is always registered as "mm"; the other variants are
+ * compiled with their mm_* entry points and team renamed (see the
+ * Makefile) so they can be linked into the same binary.
+ */
+typedef struct {
+    char *name;                               /* name used with mdriver -A */
+    int (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    void *(*memalign)(size_t alignment, size_t size); /* NULL if unsupported */
+    void *(*calloc)(size_t nmemb, size_t size);       /* NULL if unsupported */
+    size_t (*malloc_batch)(size_t size, size_t n, void **ptrs); /* ditto */
+    void (*free_batch)(void **ptrs, size_t n);        /* NULL if unsupported */
+    void (*free_sized)(void *ptr, size_t size);       /* NULL if unsupported */
+    mm_arena_t *(*arena_create)(void);                /* NULL if unsupported */
+    void *(*arena_alloc)(mm_arena_t *arena, size_t size);
+    void (*arena_reset)(mm_arena_t *arena);
+    void (*arena_destroy)(mm_arena_t *arena);
+    void (*heap_walk)(mm_walk_fn fn, void *arg);      /* NULL if unsupported */
+    int (*stats)(mm_stats_t *stats);                  /* NULL if unsupported */
+    team_t *team;
+} mm_allocator_t;
+
+extern mm_allocator_t *mm_allocators[];      /* NULL terminated registry */
+extern mm_allocator_t *mm_find_allocator(char *name);
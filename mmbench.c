@@ -0,0 +1,358 @@
+/*
+ * mmbench.c - Microbenchmarks for single allocator operations.
+ *
+ * mdriver times whole traces. mmbench instead runs one kind of
+ * operation in a tight loop, so a slowdown can be pinned on the code
+ * behind it:
+ *
+ *     lifo     malloc and free of one size - the quick list path of mm-quick
+ *     fifo     free the oldest of 256 blocks and malloc a new one
+ *     random   replace random blocks among 1024 with random sizes up to
+ *              1KB - place, split and coalesce
+ *     realloc  16 interleaved blocks grown by 64 bytes at a time, up to 8KB
+ *     fit      malloc of blocks bigger than any of 1000 free holes - the
+ *              worst case find_fit, which visits every one of them
+ *
+ * Every case is run against the allocators in mm_allocators[] (mm.c,
+ * its variants and mm-firstfit.c) and libc malloc:
+ *
+ *     unix> make mmbench && ./mmbench -A mm,firstfit,libc
+ *
+ * Each sample sets up a fresh heap, untimed, then times the loop with
+ * the cycle counter. After WARMUP samples are thrown away the K fastest
+ * are required to agree within EPSILON (up to MAXSAMPLES), and the
+ * fastest is reported as cycles (of the time stamp counter) and ns per
+ * operation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "clock.h"
+
+#define WARMUP      2     /* samples thrown away first */
+#define K           3     /* samples that have to agree */
+#define EPSILON     0.02  /* by this much */
+#define MAXSAMPLES  30    /* give up and take the best after this many */
+
+#define STEPS       4096  /* loop iterations per sample */
+#define LIFO_SIZE   64    /* block size of the lifo case */
+#define RING        256   /* blocks live in the fifo case */
+#define FIFO_SIZE   64    /* their size */
+#define SLOTS       1024  /* blocks live in the random case */
+#define RANDOM_MAX  1024  /* largest of their sizes */
+#define CHAINS      16    /* blocks grown in the realloc case */
+#define GROW        64    /* bytes they grow by per realloc */
+#define GROW_MAX    8192  /* size they start over from */
+#define HOLES       1000  /* free blocks in the fit case */
+#define HOLE_SIZE   600   /* their size - past mm-quick's quick lists */
+#define FIT_SIZE    5000  /* blocks that fit in none of them */
+#define FIT_STEPS   200   /* mallocs of those per sample */
+
+/* One microbenchmark: run returns the number of operations it timed */
+typedef struct {
+    char *name;
+    void (*setup)(mm_allocator_t *a);
+    long (*run)(mm_allocator_t *a);
+    void (*teardown)(mm_allocator_t *a);
+} bench_t;
+
+static void *blocks[2*HOLES + FIT_STEPS]; /* the live blocks of a case */
+static size_t sizes[CHAINS];              /* current sizes in the realloc case */
+static int rand_slot[STEPS];              /* the random case's choices */
+static size_t rand_size[STEPS];
+
+/* libc malloc, in the registry's format */
+static int libc_init(void) { return 0; }
+
+static mm_allocator_t libc_allocator = {
+    "libc", libc_init, malloc, free, realloc, NULL, NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+static void fresh_heap(mm_allocator_t *a);
+static void free_blocks(mm_allocator_t *a, int n);
+
+/*
+ * The cases
+ */
+static void lifo_setup(mm_allocator_t *a)
+{
+    fresh_heap(a);
+}
+
+static long lifo_run(mm_allocator_t *a)
+{
+    int i;
+
+    for (i = 0; i < STEPS; i++)
+        a->free(a->malloc(LIFO_SIZE));
+    return 2*STEPS;
+}
+
+static void lifo_teardown(mm_allocator_t *a)
+{
+}
+
+static void fifo_setup(mm_allocator_t *a)
+{
+    int i;
+
+    fresh_heap(a);
+    for (i = 0; i < RING; i++)
+        blocks[i] = a->malloc(FIFO_SIZE);
+}
+
+static long fifo_run(mm_allocator_t *a)
+{
+    int i;
+
+    for (i = 0; i < STEPS; i++) {
+        a->free(blocks[i % RING]);
+        blocks[i % RING] = a->malloc(FIFO_SIZE);
+    }
+    return 2*STEPS;
+}
+
+static void fifo_teardown(mm_allocator_t *a)
+{
+    free_blocks(a, RING);
+}
+
+static void random_setup(mm_allocator_t *a)
+{
+    int i;
+
+    fresh_heap(a);
+    for (i = 0; i < SLOTS; i++)
+        blocks[i] = a->malloc(rand_size[i]);
+}
+
+static long random_run(mm_allocator_t *a)
+{
+    int i;
+
+    for (i = 0; i < STEPS; i++) {
+        a->free(blocks[rand_slot[i]]);
+        blocks[rand_slot[i]] = a->malloc(rand_size[i]);
+    }
+    return 2*STEPS;
+}
+
+static void random_teardown(mm_allocator_t *a)
+{
+    free_blocks(a, SLOTS);
+}
+
+static void realloc_setup(mm_allocator_t *a)
+{
+    int i;
+
+    fresh_heap(a);
+    for (i = 0; i < CHAINS; i++) {
+        sizes[i] = GROW * (i + 1);
+        blocks[i] = a->malloc(sizes[i]);
+    }
+}
+
+static long realloc_run(mm_allocator_t *a)
+{
+    int i, c;
+
+    for (i = 0; i < STEPS; i++) {
+        c = i % CHAINS;
+        if ((sizes[c] += GROW) > GROW_MAX)
+            sizes[c] = GROW;
+        blocks[c] = a->realloc(blocks[c], sizes[c]);
+    }
+    return STEPS;
+}
+
+static void realloc_teardown(mm_allocator_t *a)
+{
+    free_blocks(a, CHAINS);
+}
+
+/* Holes separated by small allocated blocks, so they cannot coalesce */
+static void fit_setup(mm_allocator_t *a)
+{
+    int i;
+
+    fresh_heap(a);
+    for (i = 0; i < 2*HOLES; i += 2) {
+        blocks[i] = a->malloc(HOLE_SIZE);
+        blocks[i+1] = a->malloc(16);
+    }
+    for (i = 0; i < 2*HOLES; i += 2) {
+        a->free(blocks[i]);
+        blocks[i] = NULL;
+    }
+}
+
+static long fit_run(mm_allocator_t *a)
+{
+    int i;
+
+    for (i = 0; i < FIT_STEPS; i++)
+        blocks[2*HOLES + i] = a->malloc(FIT_SIZE);
+    return FIT_STEPS;
+}
+
+static void fit_teardown(mm_allocator_t *a)
+{
+    free_blocks(a, 2*HOLES + FIT_STEPS);
+}
+
+static bench_t benches[] = {
+    { "lifo", lifo_setup, lifo_run, lifo_teardown },
+    { "fifo", fifo_setup, fifo_run, fifo_teardown },
+    { "random", random_setup, random_run, random_teardown },
+    { "realloc", realloc_setup, realloc_run, realloc_teardown },
+    { "fit", fit_setup, fit_run, fit_teardown },
+};
+#define NBENCHES (int)(sizeof(benches) / sizeof(benches[0]))
+
+/*
+ * fresh_heap - Start allocator a on an empty heap. libc's heap cannot
+ * be reset, every case frees all its blocks instead.
+ */
+static void fresh_heap(mm_allocator_t *a)
+{
+    if (a != &libc_allocator)
+        mem_reset_brk();
+    if (a->init() < 0) {
+        fprintf(stderr, "mmbench: %s init failed\n", a->name);
+        exit(1);
+    }
+}
+
+/* free_blocks - Free the first n of blocks that are not NULL */
+static void free_blocks(mm_allocator_t *a, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (blocks[i] != NULL)
+            a->free(blocks[i]);
+        blocks[i] = NULL;
+    }
+}
+
+/*
+ * time_bench - Cycles per operation of bench b on allocator a, the
+ * best of the K best samples once they agree
+ */
+static double time_bench(bench_t *b, mm_allocator_t *a)
+{
+    double best[K];   /* the K fastest samples so far, fastest first */
+    double cyc;
+    long ops = 1;
+    int samples, n = 0, i;
+
+    for (samples = 0; samples < WARMUP + MAXSAMPLES; samples++) {
+        b->setup(a);
+        start_counter();
+        ops = b->run(a);
+        cyc = get_counter();
+        b->teardown(a);
+        if (samples < WARMUP)
+            continue;
+
+        /* Keep the K fastest, in order */
+        if (n < K)
+            n++;
+        else if (cyc >= best[K-1])
+            continue;
+        for (i = n - 1; i > 0 && best[i-1] > cyc; i--)
+            best[i] = best[i-1];
+        best[i] = cyc;
+        if (n == K && best[K-1] <= (1 + EPSILON) * best[0])
+            break;
+    }
+    return best[0] / ops;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mmbench [-h] [-A <name>,...|all] [-c <case>,...]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-A <names> Allocators to run, from mdriver -A or libc (mm,firstfit,libc).\n");
+    fprintf(stderr, "\t           \"all\" runs every one.\n");
+    fprintf(stderr, "\t-c <names> Cases to run: lifo, fifo, random, realloc, fit (all).\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+}
+
+/* listed - Returns true if name is one of the comma separated names in list */
+static int listed(char *list, char *name)
+{
+    size_t len = strlen(name);
+    char *p;
+
+    for (p = list; (p = strstr(p, name)) != NULL; p += len) {
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char *alloc_names = "mm,firstfit,libc"; /* -A */
+    char *case_names = NULL;                /* -c, NULL for all */
+    mm_allocator_t *allocs[64];
+    int nallocs = 0;
+    double ghz, cyc;
+    int c, i, j;
+
+    while ((c = getopt(argc, argv, "A:c:h")) != EOF) {
+        switch (c) {
+        case 'A':
+            alloc_names = optarg;
+            break;
+        case 'c':
+            case_names = optarg;
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(1);
+        }
+    }
+
+    /* Registry order, with libc last */
+    for (i = 0; mm_allocators[i] != NULL && nallocs < 63; i++) {
+        if (!strcmp(alloc_names, "all") || listed(alloc_names, mm_allocators[i]->name))
+            allocs[nallocs++] = mm_allocators[i];
+    }
+    if (!strcmp(alloc_names, "all") || listed(alloc_names, "libc"))
+        allocs[nallocs++] = &libc_allocator;
+    if (nallocs == 0) {
+        fprintf(stderr, "mmbench: no allocator called %s\n", alloc_names);
+        exit(1);
+    }
+
+    srand(1);
+    for (i = 0; i < STEPS; i++) {
+        rand_slot[i] = rand() % SLOTS;
+        rand_size[i] = 1 + rand() % RANDOM_MAX;
+    }
+    mem_init();
+    ghz = mhz_full(0, 1) / 1e3;
+
+    printf("%-10s %-14s %10s %10s\n", "case", "allocator", "cycles/op", "ns/op");
+    for (i = 0; i < NBENCHES; i++) {
+        if (case_names != NULL && !listed(case_names, benches[i].name))
+            continue;
+        for (j = 0; j < nallocs; j++) {
+            cyc = time_bench(&benches[i], allocs[j]);
+            printf("%-10s %-14s %10.1f %10.1f\n", benches[i].name,
+                   allocs[j]->name, cyc, cyc / ghz);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,390 @@
+/*
+ * mtbench.c - Multi-threaded allocator benchmarks, after the classic
+ *     stress tests:
+ *
+ *     threadtest     every thread mallocs and frees batches of its own
+ *     larson         server style: threads replace random blocks of
+ *                    random size, and hand their blocks on to the next
+ *                    thread every round, which frees them
+ *     xmalloc        producer/consumer: batches malloc'd by one thread
+ *                    go through a queue and are freed by another
+ *     cache-scratch  objects malloc'd side by side by one thread are
+ *                    freed by one worker each, which then mallocs and
+ *                    writes small objects - false sharing if the
+ *                    allocator hands those out on a shared cache line
+ *
+ * It calls plain malloc and free, so it measures libc as it is and
+ * mm.c when libmm.so (mm.c behind one global lock) is preloaded:
+ *
+ *     unix> make mtbench libmm.so
+ *     unix> ./mtbench -t 8
+ *     unix> LD_PRELOAD=./libmm.so ./mtbench -t 8
+ *
+ * Each benchmark runs at 1, 2, 4, ... threads up to -t (the number of
+ * CPUs by default), each thread doing the same amount of work, and
+ * prints the malloc and free calls per second of all threads together
+ * and the peak RSS. Every run is in a child process of its own, so the
+ * peak RSS is that of the run alone.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MAXTHREADS 64
+
+#define TT_ROUNDS  50     /* threadtest: batches per thread */
+#define TT_OBJS    10000  /* blocks per batch */
+#define TT_SIZE    64     /* their size */
+
+#define LR_ROUNDS  20     /* larson: rounds, each ending in a handoff */
+#define LR_STEPS   20000  /* blocks replaced per round */
+#define LR_SLOTS   1000   /* blocks a thread holds */
+#define LR_MIN     16     /* their sizes */
+#define LR_MAX     512
+
+#define XM_ROUNDS  5000   /* xmalloc: batches produced per thread */
+#define XM_BATCH   100    /* blocks per batch */
+#define XM_SIZE    64     /* their size */
+
+#define CS_ROUNDS  100000 /* cache-scratch: mallocs per thread */
+#define CS_WRITES  100    /* writes to each block */
+#define CS_SIZE    8      /* its size */
+
+/* Each thread gets one of these */
+typedef struct {
+    int id;
+    int nthreads;
+    long ops;             /* malloc and free calls made */
+    unsigned seed;        /* for rand_r */
+} thread_t;
+
+typedef struct {
+    char *name;
+    void *(*thread)(void *arg);  /* run by every thread on its thread_t */
+    void (*setup)(int nthreads); /* run before the threads start, or NULL */
+} bench_t;
+
+/* What a child reports to the parent */
+typedef struct {
+    double secs;
+    long ops;
+} result_t;
+
+static pthread_barrier_t barrier; /* the worker threads, and main at start */
+static double scale = 1;          /* multiplies every round count (-n) */
+
+static long rounds(long n)
+{
+    return (long)(n * scale) > 0 ? (long)(n * scale) : 1;
+}
+
+static void unix_error(char *msg)
+{
+    perror(msg);
+    exit(1);
+}
+
+static void *checked_malloc(size_t size)
+{
+    void *p;
+
+    if ((p = malloc(size)) == NULL) {
+        fprintf(stderr, "mtbench: malloc(%zu) failed\n", size);
+        exit(1);
+    }
+    return p;
+}
+
+/*
+ * threadtest
+ */
+static void *threadtest(void *arg)
+{
+    thread_t *t = arg;
+    char **objs = checked_malloc(TT_OBJS * sizeof(char *));
+    long r, n = rounds(TT_ROUNDS);
+    int i;
+
+    pthread_barrier_wait(&barrier);
+    for (r = 0; r < n; r++) {
+        for (i = 0; i < TT_OBJS; i++) {
+            objs[i] = checked_malloc(TT_SIZE);
+            objs[i][0] = i;
+        }
+        for (i = 0; i < TT_OBJS; i++)
+            free(objs[i]);
+    }
+    t->ops = 2 * n * TT_OBJS;
+    free(objs);
+    return NULL;
+}
+
+/*
+ * larson - In round r thread i works on the blocks thread i+r started
+ * with, so after the first round every free is of a block some other
+ * thread malloc'd.
+ */
+static char **lr_slots[MAXTHREADS];
+static pthread_barrier_t lr_barrier; /* the end of a round */
+
+static void larson_setup(int nthreads)
+{
+    int i, k;
+
+    pthread_barrier_init(&lr_barrier, NULL, nthreads);
+    for (i = 0; i < nthreads; i++) {
+        lr_slots[i] = checked_malloc(LR_SLOTS * sizeof(char *));
+        for (k = 0; k < LR_SLOTS; k++)
+            lr_slots[i][k] = NULL;
+    }
+}
+
+static void *larson(void *arg)
+{
+    thread_t *t = arg;
+    char **slots;
+    long r, n = rounds(LR_ROUNDS);
+    int i, k;
+
+    pthread_barrier_wait(&barrier);
+    for (r = 0; r < n; r++) {
+        slots = lr_slots[(t->id + r) % t->nthreads];
+        for (i = 0; i < LR_STEPS; i++) {
+            k = rand_r(&t->seed) % LR_SLOTS;
+            free(slots[k]);
+            slots[k] = checked_malloc(LR_MIN + rand_r(&t->seed) % (LR_MAX - LR_MIN + 1));
+            slots[k][0] = i;
+        }
+        t->ops += 2 * LR_STEPS;
+        pthread_barrier_wait(&lr_barrier);
+    }
+
+    /* Every thread ends on a different set of blocks */
+    for (k = 0; k < LR_SLOTS; k++)
+        free(slots[k]);
+    return NULL;
+}
+
+/*
+ * xmalloc - Batches go through a FIFO queue that keeps one batch back,
+ * so a thread frees the batch put there before its own, which is
+ * mostly another thread's.
+ */
+#define XM_QUEUE 4
+static pthread_mutex_t xm_lock = PTHREAD_MUTEX_INITIALIZER;
+static char **xm_queue[XM_QUEUE];
+static int xm_head, xm_tail, xm_len;
+
+static void *xmalloc_bench(void *arg)
+{
+    thread_t *t = arg;
+    char **batch;
+    long r, n = rounds(XM_ROUNDS);
+    int i;
+
+    pthread_barrier_wait(&barrier);
+    for (r = 0; r < n; r++) {
+        /* Produce a batch... */
+        batch = checked_malloc(XM_BATCH * sizeof(char *));
+        for (i = 0; i < XM_BATCH; i++) {
+            batch[i] = checked_malloc(XM_SIZE);
+            batch[i][0] = i;
+        }
+        pthread_mutex_lock(&xm_lock);
+        xm_queue[xm_tail] = batch;
+        xm_tail = (xm_tail + 1) % XM_QUEUE;
+        xm_len++;
+
+        /* ... and consume the oldest one */
+        batch = NULL;
+        if (xm_len > 1) {
+            batch = xm_queue[xm_head];
+            xm_head = (xm_head + 1) % XM_QUEUE;
+            xm_len--;
+        }
+        pthread_mutex_unlock(&xm_lock);
+        if (batch == NULL)
+            continue;
+        for (i = 0; i < XM_BATCH; i++)
+            free(batch[i]);
+        free(batch);
+        t->ops += 2 * (XM_BATCH + 1);
+    }
+    return NULL;
+}
+
+/*
+ * cache-scratch
+ */
+static char *cs_objs[MAXTHREADS];
+
+static void scratch_setup(int nthreads)
+{
+    int i;
+
+    for (i = 0; i < nthreads; i++)
+        cs_objs[i] = checked_malloc(CS_SIZE);
+}
+
+static void *scratch(void *arg)
+{
+    thread_t *t = arg;
+    volatile char *p;
+    long r, n = rounds(CS_ROUNDS);
+    int w;
+
+    pthread_barrier_wait(&barrier);
+    free(cs_objs[t->id]);
+    for (r = 0; r < n; r++) {
+        p = checked_malloc(CS_SIZE);
+        for (w = 0; w < CS_WRITES; w++)
+            p[w % CS_SIZE]++;
+        free((void *)p);
+    }
+    t->ops = 2 * n + 1;
+    return NULL;
+}
+
+static bench_t benches[] = {
+    { "threadtest", threadtest, NULL },
+    { "larson", larson, larson_setup },
+    { "xmalloc", xmalloc_bench, NULL },
+    { "cache-scratch", scratch, scratch_setup },
+};
+#define NBENCHES (int)(sizeof(benches) / sizeof(benches[0]))
+
+/*
+ * run_bench - Run b with nthreads threads and return the time from
+ * the moment they all start until the last one is done
+ */
+static result_t run_bench(bench_t *b, int nthreads)
+{
+    pthread_t tids[MAXTHREADS];
+    thread_t threads[MAXTHREADS];
+    struct timespec start, end;
+    result_t res = { 0, 0 };
+    int i;
+
+    if (b->setup != NULL)
+        b->setup(nthreads);
+    pthread_barrier_init(&barrier, NULL, nthreads + 1);
+    for (i = 0; i < nthreads; i++) {
+        threads[i].id = i;
+        threads[i].nthreads = nthreads;
+        threads[i].ops = 0;
+        threads[i].seed = i + 1;
+        if (pthread_create(&tids[i], NULL, b->thread, &threads[i]) != 0)
+            unix_error("pthread_create failed in run_bench");
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_barrier_wait(&barrier);
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(tids[i], NULL);
+        res.ops += threads[i].ops;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    res.secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return res;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mtbench [-h] [-t <threads>] [-n <scale>] [-b <name>,...]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b <names>   Benchmarks to run: threadtest, larson, xmalloc,\n");
+    fprintf(stderr, "\t             cache-scratch (all).\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+    fprintf(stderr, "\t-n <scale>   Multiply the work of every thread by scale (1).\n");
+    fprintf(stderr, "\t-t <threads> Most threads to run with (one per CPU).\n");
+}
+
+/* listed - Returns true if name is one of the comma separated names in list */
+static int listed(char *list, char *name)
+{
+    size_t len = strlen(name);
+    char *p;
+
+    for (p = list; (p = strstr(p, name)) != NULL; p += len) {
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int maxthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    char *names = NULL;      /* -b, NULL for all */
+    char *preload = getenv("LD_PRELOAD");
+    int fds[2];
+    result_t res;
+    struct rusage ru;
+    pid_t pid;
+    int c, i, n, status;
+
+    while ((c = getopt(argc, argv, "b:n:t:h")) != EOF) {
+        switch (c) {
+        case 'b':
+            names = optarg;
+            break;
+        case 'n':
+            scale = atof(optarg);
+            break;
+        case 't':
+            maxthreads = atoi(optarg);
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if (maxthreads < 1 || maxthreads > MAXTHREADS || scale <= 0) {
+        usage();
+        exit(1);
+    }
+
+    printf("malloc: %s\n", preload ? preload : "libc");
+    printf("%-14s %7s %12s %14s\n", "benchmark", "threads", "Kops/s", "peak RSS (KB)");
+    fflush(stdout);
+    for (i = 0; i < NBENCHES; i++) {
+        if (names != NULL && !listed(names, benches[i].name))
+            continue;
+        for (n = 1; ; n = (2*n < maxthreads) ? 2*n : maxthreads) {
+            if (pipe(fds) < 0)
+                unix_error("pipe failed in main");
+            if ((pid = fork()) < 0)
+                unix_error("fork failed in main");
+            if (pid == 0) {
+                close(fds[0]);
+                res = run_bench(&benches[i], n);
+                if (write(fds[1], &res, sizeof(res)) != sizeof(res))
+                    unix_error("write failed in main");
+                _exit(0);
+            }
+            close(fds[1]);
+            if (read(fds[0], &res, sizeof(res)) != sizeof(res))
+                res.secs = 0;
+            close(fds[0]);
+            if (wait4(pid, &status, 0, &ru) < 0)
+                unix_error("wait4 failed in main");
+            if (res.secs <= 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                printf("%-14s %7d %12s\n", benches[i].name, n, "failed");
+            else
+                printf("%-14s %7d %12.0f %14ld\n", benches[i].name, n,
+                       res.ops / res.secs / 1e3, ru.ru_maxrss);
+            fflush(stdout);
+            if (n == maxthreads)
+                break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * sizebench.c - Times block_size, mm.c's computation of the block size
+ * for a request, which every allocation starts with:
+ *
+ *     unix> make sizebench && ./sizebench
+ *
+ * mm.c is included rather than linked, so what is timed is the very
+ * routine mm.c inlines. Next to it the form it replaced, with branches
+ * for small and classed sizes and a divide, runs on the same sizes:
+ * one size over and over, and random sizes within the class table, up
+ * to 1KB (half of them past the table, where branches mispredict most)
+ * and up to 4KB.
+ *
+ * Each case is timed with fcyc (K-best, after a warmup pass) over
+ * NSIZES sizes, REPS times. Cycles are those of the time stamp counter.
+ */
+#include "mm.c"
+#include "fcyc.h"
+#include "clock.h"
+
+#define NSIZES 65536 /* sizes in a mix */
+#define REPS   1     /* passes over them per sample */
+
+static size_t sizes[NSIZES];
+static volatile size_t sink;  /* keeps the sums from being optimized away */
+
+/* old_block_size - block_size with the branches and divide it had */
+static inline size_t old_block_size(size_t size)
+{
+    if (size <= MM_CLASS_MAX)
+        size = mm_class_size[mm_class_index[(size + 7) >> 3]];
+    if (size <= DSIZE)
+        return DSIZE + OVERHEAD;
+    return DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
+}
+
+static void run_new(void *arg)
+{
+    size_t sum = 0;
+    int i, r;
+
+    for (r = 0; r < REPS; r++)
+        for (i = 0; i < NSIZES; i++)
+            sum += block_size(sizes[i]);
+    sink += sum;
+}
+
+static void run_old(void *arg)
+{
+    size_t sum = 0;
+    int i, r;
+
+    for (r = 0; r < REPS; r++)
+        for (i = 0; i < NSIZES; i++)
+            sum += old_block_size(sizes[i]);
+    sink += sum;
+}
+
+/* fill - Fill sizes with random sizes from 1 to max (all max if fixed) */
+static void fill(size_t max, int fixed)
+{
+    int i;
+
+    srand(1);
+    for (i = 0; i < NSIZES; i++)
+        sizes[i] = fixed ? max : 1 + rand() % max;
+}
+
+/* time_call - Cycles per call of f on the current sizes */
+static double time_call(test_funct f)
+{
+    f(NULL);
+    return fcyc(f, NULL) / ((double)NSIZES * REPS);
+}
+
+int main(void)
+{
+    static const struct {
+        char *name;
+        size_t max;
+        int fixed;
+    } mixes[] = {
+        { "one size (40)", 40, 1 },
+        { "in the table", MM_CLASS_MAX, 0 },
+        { "up to 1024", 1024, 0 },
+        { "up to 4096", 4096, 0 },
+    };
+    double ghz = mhz_full(0, 1) / 1e3;
+    double old, new;
+    int i;
+
+    set_fcyc_k(3);
+    set_fcyc_maxsamples(20);
+    set_fcyc_epsilon(0.01);
+
+    printf("%-18s %22s %22s\n", "sizes", "block_size", "old form");
+    printf("%-18s %11s %10s %11s %10s\n", "", "cycles", "ns", "cycles", "ns");
+    for (i = 0; i < (int)(sizeof(mixes) / sizeof(mixes[0])); i++) {
+        fill(mixes[i].max, mixes[i].fixed);
+        new = time_call(run_new);
+        old = time_call(run_old);
+        printf("%-18s %11.2f %10.2f %11.2f %10.2f\n", mixes[i].name,
+               new, new / ghz, old, old / ghz);
+    }
+    return 0;
+}